@@ -0,0 +1,50 @@
+////////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License.  You may obtain a copy
+// of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+// License for the specific language governing permissions and limitations
+// under the License.
+////////////////////////////////////////////////////////////////////////////////
+
+#version 450 core
+
+layout(binding = 0, std430) readonly buffer CONSTANT
+{
+  mat4 viewproj;
+  uint data[48];
+  float palette_factor;
+} g_constant;
+
+layout(binding = 8, std430) readonly buffer PARTICLE_CACHE
+{
+  vec4 particle[];
+} g_cache;
+
+out gl_PerVertex
+{
+  vec4 gl_Position;
+  float gl_PointSize;
+};
+
+layout(location = 0) out INVOCATION
+{
+  float texcoord;
+} vs_out;
+
+// Pass-through variant of VS_Particle_Draw.vert, reads what CS_Particle_Evaluate.comp cached.
+void main(void)
+{
+  vec4 p = g_cache.particle[gl_VertexIndex];
+
+  gl_Position = g_constant.viewproj * vec4(p.xyz, 1.0);
+  gl_PointSize = 1.0;
+  vs_out.texcoord = p.w;
+}
@@ -16,6 +16,9 @@ move frag.spv FS_Graph.spv
 glslangValidator -V -H FS_Particle_Draw.frag >  FS_Particle_Draw.spv.txt
 move frag.spv FS_Particle_Draw.spv
 
+glslangValidator -V -H FS_Particle_Draw_Push.frag >  FS_Particle_Draw_Push.spv.txt
+move frag.spv FS_Particle_Draw_Push.spv
+
 glslangValidator -V -H FS_Skybox.frag >  FS_Skybox.spv.txt
 move frag.spv FS_Skybox.spv
 
@@ -31,6 +34,12 @@ move vert.spv VS_Graph.spv
 glslangValidator -V -H VS_Particle_Draw.vert >  VS_Particle_Draw.spv.txt
 move vert.spv VS_Particle_Draw.spv
 
+glslangValidator -V -H VS_Particle_Draw_Push.vert >  VS_Particle_Draw_Push.spv.txt
+move vert.spv VS_Particle_Draw_Push.spv
+
+glslangValidator -V -H VS_Particle_Cached.vert >  VS_Particle_Cached.spv.txt
+move vert.spv VS_Particle_Cached.spv
+
 glslangValidator -V -H VS_Quad_LL.vert >  VS_Quad_LL.spv.txt
 move vert.spv VS_Quad_LL.spv
 
@@ -43,6 +52,12 @@ move vert.spv VS_Quad_UL_INV.spv
 glslangValidator -V -H VS_Skybox.vert >  VS_Skybox.spv.txt
 move vert.spv VS_Skybox.spv
 
+glslangValidator -V -H VS_Skybox_Push.vert >  VS_Skybox_Push.spv.txt
+move vert.spv VS_Skybox_Push.spv
+
 glslangValidator -V -H CS_Skybox_Generate.comp >  CS_Skybox_Generate.spv.txt
 move comp.spv CS_Skybox_Generate.spv
 
+glslangValidator -V -H CS_Particle_Evaluate.comp >  CS_Particle_Evaluate.spv.txt
+move comp.spv CS_Particle_Evaluate.spv
+
@@ -0,0 +1,7 @@
+..\..\Stardust.exe -convert-texture -bc1 -mips Skybox.sdtx Skybox_right1.png Skybox_left2.png Skybox_top3.png Skybox_bottom4.png Skybox_front5.png Skybox_back6.png
+
+..\..\Stardust.exe -convert-texture Palette_Fire.sdtx Palette_Fire.png
+..\..\Stardust.exe -convert-texture Palette_Purple.sdtx Palette_Purple.png
+..\..\Stardust.exe -convert-texture Palette_Muted.sdtx Palette_Muted.png
+..\..\Stardust.exe -convert-texture Palette_Rainbow.sdtx Palette_Rainbow.png
+..\..\Stardust.exe -convert-texture Palette_Sky.sdtx Palette_Sky.png
@@ -0,0 +1,412 @@
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "Benchmark.h"
+#include "Misc.h"
+#include "SDL.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define k_Max_Config 32
+
+// Per-frame metrics, the phases and threads follow the fixed ones
+enum
+{
+    METRIC_FRAME = 0,
+    METRIC_THREAD_MAX,                  // slowest recording thread, the critical path
+    METRIC_THREAD_SUM,                  // recording time of all threads
+    METRIC_PHASE_0
+};
+//=============================================================================
+typedef struct BENCH_STATS
+{
+    float                               min;
+    float                               mean;
+    float                               p50;
+    float                               p95;
+    float                               p99;
+    float                               max;
+} BENCH_STATS;
+
+typedef struct BENCH_CONFIG
+{
+    char                                key[32];
+    char                                value[128];
+    int                                 is_string;
+} BENCH_CONFIG;
+//=============================================================================
+static int                              s_warmup_frames;
+static int                              s_frame_count;
+static int                              s_phase_count;
+static int                              s_thread_count;
+static int                              s_metric_count;
+static const char                       **s_phase_names;
+static int                              s_gpu_pass_count;
+static const char                       **s_gpu_pass_names;
+static float                            *s_gpu_current;
+static int                              s_gpu_valid;
+static float                            *s_gpu_sample;
+static int                              s_gpu_sample_count;
+static int                              s_frame;
+static Uint64                           s_frame_begin;
+static Uint64                           *s_current;
+static float                            *s_sample;
+static int                              s_frame_draws;
+static Uint64                           s_measured_draws;
+static Uint64                           s_measured_ticks;
+static double                           s_ms_per_tick;
+static BENCH_CONFIG                     s_config[k_Max_Config];
+static int                              s_config_count;
+//=============================================================================
+static int Compare_Float(const void *a, const void *b)
+{
+    float fa = *(const float *)a, fb = *(const float *)b;
+    return (fa > fb) - (fa < fb);
+}
+//-----------------------------------------------------------------------------
+static float Percentile(const float *sorted, int count, int percent)
+{
+    // nearest rank
+    int rank = (count * percent + 99) / 100;
+    return sorted[SDL_max(rank, 1) - 1];
+}
+//-----------------------------------------------------------------------------
+static BENCH_STATS Compute_Sample_Stats(const float *sample, int count)
+{
+    BENCH_STATS stats = { 0 };
+    if (!count) return stats;
+
+    float *sorted = malloc(count * sizeof(float));
+    if (!sorted) return stats;
+    memcpy(sorted, sample, count * sizeof(float));
+    qsort(sorted, count, sizeof(float), Compare_Float);
+
+    double sum = 0.0;
+    for (int i = 0; i < count; ++i) {
+        sum += sorted[i];
+    }
+    stats.min = sorted[0];
+    stats.mean = (float)(sum / count);
+    stats.p50 = Percentile(sorted, count, 50);
+    stats.p95 = Percentile(sorted, count, 95);
+    stats.p99 = Percentile(sorted, count, 99);
+    stats.max = sorted[count - 1];
+    free(sorted);
+
+    return stats;
+}
+//-----------------------------------------------------------------------------
+static BENCH_STATS Compute_Stats(int metric)
+{
+    return Compute_Sample_Stats(&s_sample[metric * s_frame_count], Benchmark_Measured_Count());
+}
+//-----------------------------------------------------------------------------
+static BENCH_STATS Compute_Gpu_Stats(int pass)
+{
+    return Compute_Sample_Stats(&s_gpu_sample[pass * s_frame_count], s_gpu_sample_count);
+}
+//-----------------------------------------------------------------------------
+static void Write_Json_String(FILE *file, const char *str)
+{
+    fputc('"', file);
+    for (; *str; ++str) {
+        if (*str == '"' || *str == '\\') fputc('\\', file);
+        if ((unsigned char)*str >= ' ') fputc(*str, file);
+    }
+    fputc('"', file);
+}
+//-----------------------------------------------------------------------------
+static void Write_Json_Stats(FILE *file, BENCH_STATS stats)
+{
+    fprintf(file, "{ \"min\": %.4f, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+            stats.min, stats.mean, stats.p50, stats.p95, stats.p99, stats.max);
+}
+//-----------------------------------------------------------------------------
+static double Measured_Seconds(void)
+{
+    return s_measured_ticks * s_ms_per_tick * 0.001;
+}
+//-----------------------------------------------------------------------------
+static double Draws_Per_Second(void)
+{
+    double seconds = Measured_Seconds();
+    return seconds > 0.0 ? s_measured_draws / seconds : 0.0;
+}
+//-----------------------------------------------------------------------------
+static int Write_Json_Report(FILE *file)
+{
+    fprintf(file, "{\n  \"config\": {");
+    for (int i = 0; i < s_config_count; ++i) {
+        fprintf(file, "%s\n    ", i ? "," : "");
+        Write_Json_String(file, s_config[i].key);
+        fprintf(file, ": ");
+        if (s_config[i].is_string) Write_Json_String(file, s_config[i].value);
+        else fprintf(file, "%s", s_config[i].value);
+    }
+    fprintf(file, "\n  },\n");
+    fprintf(file, "  \"warmup_frames\": %d,\n  \"frames\": %d,\n  \"seconds\": %.4f,\n  \"draws_per_second\": %.0f,\n",
+            s_warmup_frames, Benchmark_Measured_Count(), Measured_Seconds(), Draws_Per_Second());
+
+    fprintf(file, "  \"frame_ms\": ");
+    Write_Json_Stats(file, Compute_Stats(METRIC_FRAME));
+    fprintf(file, ",\n  \"phase_ms\": {");
+    for (int i = 0; i < s_phase_count; ++i) {
+        fprintf(file, "%s\n    ", i ? "," : "");
+        Write_Json_String(file, s_phase_names[i]);
+        fprintf(file, ": ");
+        Write_Json_Stats(file, Compute_Stats(METRIC_PHASE_0 + i));
+    }
+    fprintf(file, "\n  },\n  \"record_ms\": {\n    \"slowest_thread\": ");
+    Write_Json_Stats(file, Compute_Stats(METRIC_THREAD_MAX));
+    fprintf(file, ",\n    \"all_threads\": ");
+    Write_Json_Stats(file, Compute_Stats(METRIC_THREAD_SUM));
+    fprintf(file, ",\n    \"per_thread\": [");
+    for (int i = 0; i < s_thread_count; ++i) {
+        fprintf(file, "%s\n      ", i ? "," : "");
+        Write_Json_Stats(file, Compute_Stats(METRIC_PHASE_0 + s_phase_count + i));
+    }
+    fprintf(file, "\n    ]\n  },\n  \"gpu_frames\": %d,\n  \"gpu_ms\": {", s_gpu_sample_count);
+    for (int i = 0; i < s_gpu_pass_count; ++i) {
+        fprintf(file, "%s\n    ", i ? "," : "");
+        Write_Json_String(file, s_gpu_pass_names[i]);
+        fprintf(file, ": ");
+        Write_Json_Stats(file, Compute_Gpu_Stats(i));
+    }
+    fprintf(file, "\n  }\n}\n");
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+// One row per run. Threads are only summarized, so rows with different worker counts share
+// the same columns.
+static int Write_Csv_Report(FILE *file)
+{
+    static const char *stat_name[6] = { "min", "mean", "p50", "p95", "p99", "max" };
+
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0) {
+        for (int i = 0; i < s_config_count; ++i) {
+            fprintf(file, "%s,", s_config[i].key);
+        }
+        fprintf(file, "warmup_frames,frames,seconds,draws_per_second");
+        for (int m = 0; m < METRIC_PHASE_0 + s_phase_count; ++m) {
+            const char *name = m == METRIC_FRAME ? "frame" : m == METRIC_THREAD_MAX ? "record_slowest_thread" :
+                               m == METRIC_THREAD_SUM ? "record_all_threads" : s_phase_names[m - METRIC_PHASE_0];
+            for (int i = 0; i < 6; ++i) {
+                fprintf(file, ",%s_ms_%s", name, stat_name[i]);
+            }
+        }
+        for (int m = 0; m < s_gpu_pass_count; ++m) {
+            for (int i = 0; i < 6; ++i) {
+                fprintf(file, ",gpu_%s_ms_%s", s_gpu_pass_names[m], stat_name[i]);
+            }
+        }
+        fprintf(file, "\n");
+    }
+
+    for (int i = 0; i < s_config_count; ++i) {
+        // device names may contain commas
+        for (const char *c = s_config[i].value; *c; ++c) {
+            fputc(*c == ',' ? ' ' : *c, file);
+        }
+        fputc(',', file);
+    }
+    fprintf(file, "%d,%d,%.4f,%.0f", s_warmup_frames, Benchmark_Measured_Count(), Measured_Seconds(), Draws_Per_Second());
+    for (int m = 0; m < METRIC_PHASE_0 + s_phase_count; ++m) {
+        BENCH_STATS stats = Compute_Stats(m);
+        fprintf(file, ",%.4f,%.4f,%.4f,%.4f,%.4f,%.4f", stats.min, stats.mean, stats.p50, stats.p95, stats.p99, stats.max);
+    }
+    for (int m = 0; m < s_gpu_pass_count; ++m) {
+        BENCH_STATS stats = Compute_Gpu_Stats(m);
+        fprintf(file, ",%.4f,%.4f,%.4f,%.4f,%.4f,%.4f", stats.min, stats.mean, stats.p50, stats.p95, stats.p99, stats.max);
+    }
+    fprintf(file, "\n");
+
+    return 1;
+}
+//=============================================================================
+int Benchmark_Init(int warmup_frames, int frame_count, int phase_count, const char **phase_names,
+                   int gpu_pass_count, const char **gpu_pass_names, int thread_count)
+{
+    if (warmup_frames < 0 || frame_count < 1 || phase_count < 0 || gpu_pass_count < 0 || thread_count < 1)
+        LOG_AND_RETURN0();
+
+    s_warmup_frames = warmup_frames;
+    s_frame_count = frame_count;
+    s_phase_count = phase_count;
+    s_phase_names = phase_names;
+    s_gpu_pass_count = gpu_pass_count;
+    s_gpu_pass_names = gpu_pass_names;
+    s_gpu_valid = 0;
+    s_gpu_sample_count = 0;
+    s_thread_count = thread_count;
+    s_metric_count = METRIC_PHASE_0 + phase_count + thread_count;
+    s_frame = 0;
+    s_frame_begin = 0;
+    s_frame_draws = 0;
+    s_measured_draws = 0;
+    s_measured_ticks = 0;
+    s_ms_per_tick = 1000.0 / SDL_GetPerformanceFrequency();
+
+    s_current = calloc(s_metric_count, sizeof(*s_current));
+    s_sample = calloc((size_t)s_metric_count * frame_count, sizeof(*s_sample));
+    s_gpu_current = calloc(gpu_pass_count + 1, sizeof(*s_gpu_current));
+    s_gpu_sample = calloc((size_t)gpu_pass_count * frame_count + 1, sizeof(*s_gpu_sample));
+    if (!s_current || !s_sample || !s_gpu_current || !s_gpu_sample) LOG_AND_RETURN0();
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+void Benchmark_Shutdown(void)
+{
+    free(s_current);
+    free(s_sample);
+    free(s_gpu_current);
+    free(s_gpu_sample);
+    s_current = NULL;
+    s_sample = NULL;
+    s_gpu_current = NULL;
+    s_gpu_sample = NULL;
+    s_config_count = 0;
+}
+//-----------------------------------------------------------------------------
+void Benchmark_Config_Int(const char *key, int value)
+{
+    if (s_config_count == k_Max_Config) return;
+
+    BENCH_CONFIG *config = &s_config[s_config_count++];
+    SDL_strlcpy(config->key, key, sizeof(config->key));
+    SDL_snprintf(config->value, sizeof(config->value), "%d", value);
+    config->is_string = 0;
+}
+//-----------------------------------------------------------------------------
+void Benchmark_Config_String(const char *key, const char *value)
+{
+    if (s_config_count == k_Max_Config) return;
+
+    BENCH_CONFIG *config = &s_config[s_config_count++];
+    SDL_strlcpy(config->key, key, sizeof(config->key));
+    SDL_strlcpy(config->value, value, sizeof(config->value));
+    config->is_string = 1;
+}
+//-----------------------------------------------------------------------------
+void Benchmark_Frame(void)
+{
+    if (!s_sample) return;
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    int measured = s_frame - s_warmup_frames;
+
+    if (s_frame_begin && measured >= 0 && measured < s_frame_count) {
+        Uint64 thread_max = 0, thread_sum = 0;
+        for (int i = 0; i < s_thread_count; ++i) {
+            Uint64 ticks = s_current[METRIC_PHASE_0 + s_phase_count + i];
+            thread_max = SDL_max(thread_max, ticks);
+            thread_sum += ticks;
+        }
+        s_current[METRIC_FRAME] = now - s_frame_begin;
+        s_current[METRIC_THREAD_MAX] = thread_max;
+        s_current[METRIC_THREAD_SUM] = thread_sum;
+
+        for (int m = 0; m < s_metric_count; ++m) {
+            s_sample[m * s_frame_count + measured] = (float)(s_current[m] * s_ms_per_tick);
+        }
+        s_measured_draws += s_frame_draws;
+        s_measured_ticks += now - s_frame_begin;
+
+        if (s_gpu_valid) {
+            for (int i = 0; i < s_gpu_pass_count; ++i) {
+                s_gpu_sample[i * s_frame_count + s_gpu_sample_count] = s_gpu_current[i];
+            }
+            ++s_gpu_sample_count;
+        }
+    }
+    if (s_frame_begin) ++s_frame;
+    s_gpu_valid = 0;
+
+    memset(s_current, 0, s_metric_count * sizeof(*s_current));
+    s_frame_draws = 0;
+    s_frame_begin = now;
+}
+//-----------------------------------------------------------------------------
+Uint64 Benchmark_End_Phase(int phase, Uint64 begin)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (s_current && phase >= 0 && phase < s_phase_count) s_current[METRIC_PHASE_0 + phase] += now - begin;
+    return now;
+}
+//-----------------------------------------------------------------------------
+void Benchmark_End_Thread(int thread, Uint64 begin)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (s_current && thread >= 0 && thread < s_thread_count) s_current[METRIC_PHASE_0 + s_phase_count + thread] += now - begin;
+}
+//-----------------------------------------------------------------------------
+void Benchmark_Gpu_Pass(int pass, float ms)
+{
+    if (!s_gpu_current || pass < 0 || pass >= s_gpu_pass_count) return;
+
+    s_gpu_current[pass] = ms;
+    s_gpu_valid = 1;
+}
+//-----------------------------------------------------------------------------
+void Benchmark_Add_Draws(int count)
+{
+    s_frame_draws += count;
+}
+//-----------------------------------------------------------------------------
+int Benchmark_Measured_Count(void)
+{
+    return SDL_max(0, SDL_min(s_frame - s_warmup_frames, s_frame_count));
+}
+//-----------------------------------------------------------------------------
+int Benchmark_Write_Report(const char *filename)
+{
+    if (!s_sample) LOG_AND_RETURN0();
+
+    size_t len = strlen(filename);
+    int csv = len >= 4 && !SDL_strcasecmp(filename + len - 4, ".csv");
+
+    FILE *file = fopen(filename, csv ? "a" : "w");
+    if (!file) LOG_AND_RETURN0();
+
+    int result = csv ? Write_Csv_Report(file) : Write_Json_Report(file);
+    if (fclose(file) != 0) result = 0;
+
+    return result;
+}
+//-----------------------------------------------------------------------------
+void Benchmark_Log_Summary(void)
+{
+    BENCH_STATS frame = Compute_Stats(METRIC_FRAME);
+    BENCH_STATS record = Compute_Stats(METRIC_THREAD_MAX);
+
+    Log("Benchmark: %d frames after %d warm-up frames, %.0f draws/s\n", Benchmark_Measured_Count(), s_warmup_frames,
+        Draws_Per_Second());
+    Log("Benchmark: frame ms min %.3f mean %.3f p50 %.3f p95 %.3f p99 %.3f max %.3f\n",
+        frame.min, frame.mean, frame.p50, frame.p95, frame.p99, frame.max);
+    Log("Benchmark: slowest recording thread ms mean %.3f p99 %.3f\n", record.mean, record.p99);
+    for (int i = 0; i < s_phase_count; ++i) {
+        BENCH_STATS phase = Compute_Stats(METRIC_PHASE_0 + i);
+        Log("Benchmark: %s ms mean %.3f p99 %.3f\n", s_phase_names[i], phase.mean, phase.p99);
+    }
+    for (int i = 0; i < s_gpu_pass_count && s_gpu_sample_count; ++i) {
+        BENCH_STATS pass = Compute_Gpu_Stats(i);
+        Log("Benchmark: GPU %s ms mean %.3f p99 %.3f\n", s_gpu_pass_names[i], pass.mean, pass.p99);
+    }
+}
+//=============================================================================
@@ -0,0 +1,57 @@
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <SDL_stdinc.h>
+
+// Fixed-frame benchmark. Frame, phase and per-thread times are taken with
+// SDL_GetPerformanceCounter; the first warmup_frames frames are discarded, the next
+// frame_count frames are kept and reduced to min/mean/p50/p95/p99/max for the report.
+
+int Benchmark_Init(int warmup_frames, int frame_count, int phase_count, const char **phase_names,
+                   int gpu_pass_count, const char **gpu_pass_names, int thread_count);
+void Benchmark_Shutdown(void);
+
+// Configuration echoed into the report, in call order. Values are copied.
+void Benchmark_Config_Int(const char *key, int value);
+void Benchmark_Config_String(const char *key, const char *value);
+
+// Closes the previous frame and opens the next one. Call once per frame at the same point.
+void Benchmark_Frame(void);
+
+// Adds the time since begin to the phase and returns the current counter, so phases can be chained.
+Uint64 Benchmark_End_Phase(int phase, Uint64 begin);
+
+// Adds the time since begin to the thread. Each thread index must only be used by one thread
+// at a time, and not concurrently with Benchmark_Frame.
+void Benchmark_End_Thread(int thread, Uint64 begin);
+
+// GPU time of a pass as read back for the current frame. GPU results arrive frames late and
+// not every frame, frames without any are left out of the GPU statistics.
+void Benchmark_Gpu_Pass(int pass, float ms);
+
+void Benchmark_Add_Draws(int count);
+
+// Number of measured frames so far, the run is complete when it reaches frame_count.
+int Benchmark_Measured_Count(void);
+
+// Writes a JSON report, or a CSV row when the name ends in .csv. The header row is only written
+// to an empty CSV file, so a sweep can append all runs to one file.
+int Benchmark_Write_Report(const char *filename);
+
+// Logs the frame time statistics and the draw rate.
+void Benchmark_Log_Summary(void);
@@ -0,0 +1,209 @@
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "Jobs.h"
+#include "Misc.h"
+#include "SDL.h"
+#include <stdlib.h>
+
+//=============================================================================
+typedef struct JOB_QUEUE
+{
+    SDL_SpinLock                        lock;
+    int                                 *jobs;
+    int                                 head;
+    int                                 tail;
+} JOB_QUEUE;
+
+typedef struct JOB_WORKER
+{
+    int                                 id;
+    SDL_Thread                          *thread;
+    JOB_QUEUE                           queue;
+} JOB_WORKER;
+//=============================================================================
+static JOB_WORKER                       *s_worker;
+static int                              s_worker_count;
+static int                              s_max_job_count;
+static JOB_FUNC                         s_func;
+static void                             *s_data;
+static int                              s_submitted;
+static SDL_atomic_t                     s_pending;
+static SDL_atomic_t                     s_quit;
+static SDL_sem                          *s_wake_sem;
+static SDL_sem                          *s_done_sem;
+static JOB_THREAD_INIT_FUNC             s_thread_init;
+//=============================================================================
+static int Pop_Job(JOB_QUEUE *queue, int *job)
+{
+    int found = 0;
+
+    SDL_AtomicLock(&queue->lock);
+    if (queue->head < queue->tail) {
+        *job = queue->jobs[queue->head++];
+        found = 1;
+    }
+    SDL_AtomicUnlock(&queue->lock);
+
+    return found;
+}
+//-----------------------------------------------------------------------------
+static int Steal_Job(JOB_QUEUE *queue, int *job)
+{
+    int found = 0;
+
+    SDL_AtomicLock(&queue->lock);
+    if (queue->head < queue->tail) {
+        *job = queue->jobs[--queue->tail];
+        found = 1;
+    }
+    SDL_AtomicUnlock(&queue->lock);
+
+    return found;
+}
+//-----------------------------------------------------------------------------
+static void Execute_Jobs(int worker)
+{
+    for (;;) {
+        int job;
+        int found = Pop_Job(&s_worker[worker].queue, &job);
+
+        for (int i = 1; i < s_worker_count && !found; ++i) {
+            found = Steal_Job(&s_worker[(worker + i) % s_worker_count].queue, &job);
+        }
+        if (!found) return;
+
+        s_func(s_data, job, worker);
+
+        // the worker that retires the last job of the submission wakes Jobs_Wait
+        if (SDL_AtomicAdd(&s_pending, -1) == 1) {
+            SDL_SemPost(s_done_sem);
+        }
+    }
+}
+//-----------------------------------------------------------------------------
+static int SDLCALL Jobs_Thread(void *data)
+{
+    JOB_WORKER *worker = data;
+
+    if (s_thread_init) s_thread_init(worker->id);
+
+    for (;;) {
+        SDL_SemWait(s_wake_sem);
+        if (SDL_AtomicGet(&s_quit)) break;
+        Execute_Jobs(worker->id);
+    }
+
+    return 1;
+}
+//=============================================================================
+int Jobs_Init(int worker_count, int max_job_count, JOB_THREAD_INIT_FUNC thread_init)
+{
+    if (worker_count < 1 || max_job_count < 1) LOG_AND_RETURN0();
+
+    s_worker = calloc(worker_count, sizeof(*s_worker));
+    if (!s_worker) LOG_AND_RETURN0();
+
+    s_worker_count = worker_count;
+    s_max_job_count = max_job_count;
+    s_thread_init = thread_init;
+    s_submitted = 0;
+    SDL_AtomicSet(&s_pending, 0);
+    SDL_AtomicSet(&s_quit, 0);
+
+    s_wake_sem = SDL_CreateSemaphore(0);
+    s_done_sem = SDL_CreateSemaphore(0);
+    if (!s_wake_sem || !s_done_sem) LOG_AND_RETURN0();
+
+    for (int i = 0; i < worker_count; ++i) {
+        s_worker[i].id = i;
+        s_worker[i].queue.jobs = malloc(max_job_count * sizeof(int));
+        if (!s_worker[i].queue.jobs) LOG_AND_RETURN0();
+    }
+    for (int i = 1; i < worker_count; ++i) {
+        s_worker[i].thread = SDL_CreateThread(Jobs_Thread, "jobs", &s_worker[i]);
+        if (!s_worker[i].thread) LOG_AND_RETURN0();
+    }
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+void Jobs_Shutdown(void)
+{
+    if (!s_worker) return;
+
+    SDL_AtomicSet(&s_quit, 1);
+    for (int i = 1; i < s_worker_count; ++i) {
+        SDL_SemPost(s_wake_sem);
+    }
+    for (int i = 0; i < s_worker_count; ++i) {
+        if (s_worker[i].thread) SDL_WaitThread(s_worker[i].thread, NULL);
+        free(s_worker[i].queue.jobs);
+    }
+    free(s_worker);
+    s_worker = NULL;
+    s_worker_count = 0;
+
+    if (s_wake_sem) SDL_DestroySemaphore(s_wake_sem);
+    if (s_done_sem) SDL_DestroySemaphore(s_done_sem);
+    s_wake_sem = NULL;
+    s_done_sem = NULL;
+}
+//-----------------------------------------------------------------------------
+int Jobs_Worker_Count(void)
+{
+    return s_worker_count;
+}
+//-----------------------------------------------------------------------------
+int Jobs_Submit(JOB_FUNC func, void *data, int job_count)
+{
+    if (!s_worker || !func || job_count > s_max_job_count) LOG_AND_RETURN0();
+
+    s_func = func;
+    s_data = data;
+    s_submitted = job_count;
+    SDL_AtomicSet(&s_pending, job_count);
+
+    for (int i = 0; i < s_worker_count; ++i) {
+        JOB_QUEUE *queue = &s_worker[i].queue;
+        int first = job_count * i / s_worker_count;
+        int last = job_count * (i + 1) / s_worker_count;
+
+        SDL_AtomicLock(&queue->lock);
+        queue->head = 0;
+        queue->tail = 0;
+        for (int j = first; j < last; ++j) {
+            queue->jobs[queue->tail++] = j;
+        }
+        SDL_AtomicUnlock(&queue->lock);
+    }
+
+    for (int i = 1; i < s_worker_count; ++i) {
+        SDL_SemPost(s_wake_sem);
+    }
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+void Jobs_Wait(void)
+{
+    if (!s_submitted) return;
+
+    Execute_Jobs(0);
+    SDL_SemWait(s_done_sem);
+    s_submitted = 0;
+}
+//=============================================================================
@@ -0,0 +1,36 @@
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// Work-stealing job scheduler. Worker 0 is the thread that calls Jobs_Submit/Jobs_Wait,
+// workers 1..count-1 are background threads. Jobs of one submission are split into
+// contiguous ranges, one per worker deque; a worker that drains its own deque steals
+// from the back of the others.
+
+typedef void (*JOB_FUNC)(void *data, int job_index, int worker_index);
+typedef void (*JOB_THREAD_INIT_FUNC)(int worker_index);
+
+int Jobs_Init(int worker_count, int max_job_count, JOB_THREAD_INIT_FUNC thread_init);
+void Jobs_Shutdown(void);
+
+int Jobs_Worker_Count(void);
+
+// Queues job_count jobs and wakes the workers. Returns immediately.
+int Jobs_Submit(JOB_FUNC func, void *data, int job_count);
+
+// Executes and steals jobs on the calling thread until the whole submission is done.
+void Jobs_Wait(void);
@@ -16,6 +16,8 @@
 
 #include "Metrics.h"
 #include <errno.h>
+
+#ifdef _WIN32
 #include <ntstatus.h>
 #define WIN32_NO_STATUS
 #include <windows.h>
@@ -143,3 +145,58 @@ float *Metrics_GetCPUData(void)
 {
     return GetCpuUsage();
 }
+
+#else
+#include <stdio.h>
+#include <unistd.h>
+
+// Load of every logical processor from the /proc/stat jiffies since the previous query.
+static int                  s_cores_count;
+static unsigned long long   *s_old_busy;
+static unsigned long long   *s_old_total;
+static float                *s_cores_load_data;
+
+static float *GetCpuUsage(void)
+{
+    FILE *fp = fopen("/proc/stat", "r");
+    if (!fp) return s_cores_load_data;
+
+    char line[512];
+    while (fgets(line, sizeof(line), fp)) {
+        unsigned int i;
+        unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
+        if (sscanf(line, "cpu%u %llu %llu %llu %llu %llu %llu %llu %llu", &i, &user, &nice, &system, &idle,
+                   &iowait, &irq, &softirq, &steal) != 9 || i >= (unsigned int)s_cores_count) continue;
+
+        unsigned long long busy = user + nice + system + irq + softirq + steal;
+        unsigned long long total = busy + idle + iowait;
+        if (total > s_old_total[i]) {
+            s_cores_load_data[i] = (float)(100.0 * (busy - s_old_busy[i]) / (total - s_old_total[i]));
+        }
+        s_old_busy[i] = busy;
+        s_old_total[i] = total;
+    }
+    fclose(fp);
+
+    return s_cores_load_data;
+}
+
+int Metrics_Init(void)
+{
+    s_cores_count = (int)sysconf(_SC_NPROCESSORS_CONF);
+    if (s_cores_count < 1) return 0;
+
+    s_old_busy = new unsigned long long[s_cores_count]();
+    s_old_total = new unsigned long long[s_cores_count]();
+    s_cores_load_data = new float[s_cores_count]();
+
+    GetCpuUsage();
+    return 1;
+}
+
+float *Metrics_GetCPUData(void)
+{
+    return GetCpuUsage();
+}
+
+#endif
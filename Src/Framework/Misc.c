@@ -20,8 +20,16 @@
 #include "SDL_timer.h"
 #ifdef _WIN32
 #   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
 #endif
 #include "../Settings.h"
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 //=============================================================================
 static int s_log_enabled = 1;
 static int s_app_start_tics;
@@ -49,6 +57,49 @@ char *Load_Text_File(const char *filename)
   return data;
 }
 //=============================================================================
+void *Map_File(const char *filename, size_t *size)
+{
+    void *data = NULL;
+    *size = 0;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+
+    LARGE_INTEGER file_size;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping) {
+            data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+            if (data) *size = (size_t)file_size.QuadPart;
+        }
+    }
+    CloseHandle(file);
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) data = NULL;
+        else *size = st.st_size;
+    }
+    close(fd);
+#endif
+    return data;
+}
+//-----------------------------------------------------------------------------
+void Unmap_File(void *data, size_t size)
+{
+    if (!data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+#else
+    munmap(data, size);
+#endif
+}
+//=============================================================================
 void Log(const char* fmt, ...)
 {
     if (!s_log_enabled) return;
@@ -122,3 +173,63 @@ void Enable_Logging(int enable)
     s_log_enabled = enable;
 }
 //=============================================================================
+void Rnd_Jump(uint32_t n, uint32_t *mul, uint32_t *add)
+{
+    uint32_t m = 1, a = 0;
+    uint32_t step_m = 196314165, step_a = 907633515;
+
+    // square and multiply, step_m/step_a is the map of 2^k steps
+    for (; n; n >>= 1) {
+        if (n & 1) {
+            m = m * step_m;
+            a = a * step_m + step_a;
+        }
+        step_a = step_a * step_m + step_a;
+        step_m = step_m * step_m;
+    }
+    *mul = m;
+    *add = a;
+}
+//=============================================================================
+#if defined(_M_X64) || defined(__SSE2__)
+static __inline __m128i Mul_Lo_Epi32(__m128i a, __m128i b)
+{
+    // SSE2 has no 32-bit low multiply, combine the even and odd 32x32->64 products
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+#endif
+//-----------------------------------------------------------------------------
+void Rnd_Fill(uint32_t seed, uint32_t *dst, int count)
+{
+    int i = 0;
+
+#if defined(_M_X64) || defined(__SSE2__)
+    if (count >= 8) {
+        // 8 interleaved lanes, each advances 8 steps per iteration
+        uint32_t lane[8];
+        for (int k = 0; k < 8; ++k) lane[k] = RND_GEN(seed);
+
+        uint32_t mul, add;
+        Rnd_Jump(8, &mul, &add);
+        const __m128i m = _mm_set1_epi32((int)mul);
+        const __m128i a = _mm_set1_epi32((int)add);
+        __m128i v0 = _mm_loadu_si128((const __m128i *)&lane[0]);
+        __m128i v1 = _mm_loadu_si128((const __m128i *)&lane[4]);
+
+        for (; i + 8 <= count; i += 8) {
+            _mm_storeu_si128((__m128i *)&dst[i], v0);
+            _mm_storeu_si128((__m128i *)&dst[i + 4], v1);
+            v0 = _mm_add_epi32(Mul_Lo_Epi32(v0, m), a);
+            v1 = _mm_add_epi32(Mul_Lo_Epi32(v1, m), a);
+        }
+        seed = dst[i - 1];
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = RND_GEN(seed);
+    }
+}
+//=============================================================================
@@ -16,12 +16,17 @@
 
 #pragma once
 
+#include <stdint.h>
 #include "stb_image.h"
 
 char *Load_Text_File(const char *filename);
 char *Load_Binary_File(const char *filename, int *ret_size);
 stbi_uc *Load_Image(char const *filename, int *x, int *y, int *comp, int req_comp);
 
+// Read-only mapping of a whole file, NULL when the file is missing or empty.
+void *Map_File(const char *filename, size_t *size);
+void Unmap_File(void *data, size_t size);
+
 void Log(const char *fmt, ...);
 
 static const char *Format_Log_Message(const char *function, int line)
@@ -40,6 +45,12 @@ static const char *Format_Log_Message(const char *function, int line)
 
 #define RND_GEN(x) (x = x * 196314165 + 907633515)
 
+// RND_GEN applied n times is again affine: x * *mul + *add (mod 2^32).
+void Rnd_Jump(uint32_t n, uint32_t *mul, uint32_t *add);
+
+// dst[i] = seed after i + 1 RND_GEN steps, the sequence of a serial RND_GEN loop.
+void Rnd_Fill(uint32_t seed, uint32_t *dst, int count);
+
 void Print_Current_Time(const char *message);
 
 int Update_Frame_Stats(double *time, float *time_delta, int frame, int filter_fps, float *fps, float *ms);
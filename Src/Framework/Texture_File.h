@@ -0,0 +1,74 @@
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// Stardust texture container (.sdtx), GPU-ready texel data so startup skips PNG decoding:
+//
+//   TEXTURE_FILE_HEADER
+//   TEXTURE_FILE_LEVEL[layer_count * mip_count]   layer major, offsets from the start of the file
+//   texel data                                    every level aligned to k_Texture_File_Alignment
+//
+// Levels are tightly packed rows in the VkFormat of the header, R8G8B8A8_UNORM or one of the
+// BC1/BC7 block formats, ready to be copied into a staging buffer as they are.
+
+#include <stdint.h>
+#include <stddef.h>
+#include "VKU.h"
+
+#define k_Texture_File_Magic 0x58544453u // "SDTX"
+#define k_Texture_File_Version 1
+#define k_Texture_File_Alignment 16
+#define k_Texture_File_Max_Mips 16
+#define k_Texture_File_Max_Layers 6
+
+typedef struct TEXTURE_FILE_HEADER
+{
+    uint32_t                            magic;
+    uint32_t                            version;
+    uint32_t                            format;
+    uint32_t                            width;
+    uint32_t                            height;
+    uint32_t                            layer_count;
+    uint32_t                            mip_count;
+    uint32_t                            reserved;
+} TEXTURE_FILE_HEADER;
+
+typedef struct TEXTURE_FILE_LEVEL
+{
+    uint64_t                            offset;
+    uint64_t                            size;
+} TEXTURE_FILE_LEVEL;
+
+typedef struct TEXTURE_FILE
+{
+    void                                *data;
+    size_t                              size;
+    const TEXTURE_FILE_HEADER           *header;
+    const TEXTURE_FILE_LEVEL            *level;
+} TEXTURE_FILE;
+
+// Byte size of one width x height level, 0 for formats the container does not support.
+uint64_t Texture_File_Level_Size(VkFormat format, uint32_t width, uint32_t height);
+
+// Maps and validates filename, returns 0 when it is missing or malformed.
+int Texture_File_Open(const char *filename, TEXTURE_FILE *file);
+void Texture_File_Close(TEXTURE_FILE *file);
+
+// Offline converter, the PNGs become the layers of one container. Supported formats are
+// VK_FORMAT_R8G8B8A8_UNORM and VK_FORMAT_BC1_RGB_UNORM_BLOCK, with_mips adds a box filtered
+// mip chain down to 1x1.
+int Texture_File_Convert(const char *filename, const char **png, int layer_count, VkFormat format, int with_mips);
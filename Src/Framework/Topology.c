@@ -0,0 +1,339 @@
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "Topology.h"
+#include "Misc.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+//=============================================================================
+typedef struct LOGICAL_CPU
+{
+    int                                 os_id;
+    int                                 core;
+    int                                 smt_rank;
+    int                                 llc;
+} LOGICAL_CPU;
+//=============================================================================
+static LOGICAL_CPU                      *s_cpu;
+static int                              s_logical_count;
+static int                              s_physical_count;
+static int                              s_llc_count;
+#if defined(__linux__)
+static cpu_set_t                        *s_affinity;
+static size_t                           s_affinity_size;
+static int                              s_affinity_cpus;
+#endif
+//=============================================================================
+static int Init_Flat_Topology(int count)
+{
+    s_cpu = calloc(count, sizeof(*s_cpu));
+    if (!s_cpu) LOG_AND_RETURN0();
+
+    for (int i = 0; i < count; ++i) {
+        s_cpu[i].os_id = i;
+        s_cpu[i].core = i;
+    }
+    s_logical_count = count;
+    s_physical_count = count;
+    s_llc_count = 1;
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+#if defined(__linux__)
+static int Read_Sys_File(const char *path, char *buf, int size)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp) return 0;
+
+    int len = (int)fread(buf, 1, size - 1, fp);
+    fclose(fp);
+    buf[len > 0 ? len : 0] = '\0';
+
+    return len > 0;
+}
+//-----------------------------------------------------------------------------
+// Reads the affinity mask of the process, which is narrower than the online cpus under
+// taskset or a container cpuset. Workers may only be counted and pinned within it.
+static int Init_Affinity(void)
+{
+    for (int cpus = 1024; cpus <= (1 << 20); cpus *= 2) {
+        s_affinity = CPU_ALLOC(cpus);
+        if (!s_affinity) return 0;
+        s_affinity_size = CPU_ALLOC_SIZE(cpus);
+        s_affinity_cpus = cpus;
+
+        if (sched_getaffinity(0, s_affinity_size, s_affinity) == 0) return 1;
+
+        CPU_FREE(s_affinity);
+        s_affinity = NULL;
+        if (errno != EINVAL) break;
+    }
+
+    return 0;
+}
+//-----------------------------------------------------------------------------
+static int Is_Affine(int os_id)
+{
+    if (!s_affinity) return 1;
+    return os_id >= 0 && os_id < s_affinity_cpus && CPU_ISSET_S(os_id, s_affinity_size, s_affinity);
+}
+//-----------------------------------------------------------------------------
+// Falls back to the cpus of the affinity mask when sysfs is not readable.
+static int Init_Affinity_Topology(void)
+{
+    int count = s_affinity ? CPU_COUNT_S(s_affinity_size, s_affinity) : 0;
+    if (count < 1) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        return Init_Flat_Topology(online > 0 ? (int)online : 1);
+    }
+    if (!Init_Flat_Topology(count)) LOG_AND_RETURN0();
+
+    for (int id = 0, i = 0; id < s_affinity_cpus && i < count; ++id) {
+        if (CPU_ISSET_S(id, s_affinity_size, s_affinity)) s_cpu[i++].os_id = id;
+    }
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+// Reads the next range of a kernel cpu list ("0-3,8,10-11").
+static int Next_Cpu_Range(const char **str, int *first, int *last)
+{
+    char *end;
+    long value = strtol(*str, &end, 10);
+    if (end == *str) return 0;
+
+    *first = *last = (int)value;
+    if (*end == '-') {
+        const char *next = end + 1;
+        *last = (int)strtol(next, &end, 10);
+    }
+    *str = *end == ',' ? end + 1 : end;
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+// Returns the number of ids in the list, ids may be NULL.
+static int Parse_Cpu_List(const char *str, int *ids, int max_count)
+{
+    int count = 0, first, last;
+
+    while (Next_Cpu_Range(&str, &first, &last)) {
+        for (int id = first; id <= last; ++id, ++count) {
+            if (ids && count < max_count) ids[count] = id;
+        }
+    }
+
+    return ids && count > max_count ? max_count : count;
+}
+//-----------------------------------------------------------------------------
+// Returns the lowest cpu id of the list, used as the key of a core or cache group. rank is
+// the number of ids in the list below self.
+static int Cpu_List_Key(const char *str, int self, int *rank)
+{
+    int key = self, first, last;
+
+    *rank = 0;
+    while (Next_Cpu_Range(&str, &first, &last)) {
+        if (first < key) key = first;
+        if (first < self) *rank += (last < self ? last : self - 1) - first + 1;
+    }
+
+    return key;
+}
+//-----------------------------------------------------------------------------
+static int Dense_Index(int *keys, int *key_count, int key)
+{
+    for (int i = 0; i < *key_count; ++i) {
+        if (keys[i] == key) return i;
+    }
+    keys[*key_count] = key;
+    return (*key_count)++;
+}
+//-----------------------------------------------------------------------------
+static int Compare_Cpu(const void *a, const void *b)
+{
+    const LOGICAL_CPU *ca = a;
+    const LOGICAL_CPU *cb = b;
+
+    if (ca->smt_rank != cb->smt_rank) return ca->smt_rank - cb->smt_rank;
+    if (ca->llc != cb->llc) return ca->llc - cb->llc;
+    if (ca->core != cb->core) return ca->core - cb->core;
+    return ca->os_id - cb->os_id;
+}
+//-----------------------------------------------------------------------------
+static int Init_Sys_Topology(void)
+{
+    char buf[4096], path[256];
+
+    if (!Read_Sys_File("/sys/devices/system/cpu/online", buf, sizeof(buf))) return 0;
+
+    int count = Parse_Cpu_List(buf, NULL, 0);
+    if (count < 1) return 0;
+
+    s_cpu = calloc(count, sizeof(*s_cpu));
+    int *ids = malloc(count * sizeof(int));
+    int *core_keys = malloc(count * sizeof(int));
+    int *llc_keys = malloc(count * sizeof(int));
+    if (!s_cpu || !ids || !core_keys || !llc_keys) {
+        free(ids); free(core_keys); free(llc_keys);
+        LOG_AND_RETURN0();
+    }
+    Parse_Cpu_List(buf, ids, count);
+
+    int affine_count = 0;
+    for (int i = 0; i < count; ++i) {
+        if (Is_Affine(ids[i])) ids[affine_count++] = ids[i];
+    }
+    count = affine_count;
+    if (count < 1) {
+        free(ids); free(core_keys); free(llc_keys);
+        return 0;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        LOGICAL_CPU *cpu = &s_cpu[i];
+        int core_key = ids[i], llc_key = 0, llc_level = 0, rank;
+
+        cpu->os_id = ids[i];
+
+        sprintf(path, "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", ids[i]);
+        if (Read_Sys_File(path, buf, sizeof(buf))) {
+            core_key = Cpu_List_Key(buf, ids[i], &cpu->smt_rank);
+        }
+
+        // the highest cache level present is the LLC
+        for (int index = 0; index < 16; ++index) {
+            sprintf(path, "/sys/devices/system/cpu/cpu%d/cache/index%d/level", ids[i], index);
+            if (!Read_Sys_File(path, buf, sizeof(buf))) break;
+
+            int level = atoi(buf);
+            if (level < llc_level) continue;
+
+            sprintf(path, "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", ids[i], index);
+            if (Read_Sys_File(path, buf, sizeof(buf))) {
+                llc_level = level;
+                llc_key = Cpu_List_Key(buf, ids[i], &rank);
+            }
+        }
+
+        cpu->core = Dense_Index(core_keys, &s_physical_count, core_key);
+        cpu->llc = Dense_Index(llc_keys, &s_llc_count, llc_key);
+    }
+    s_logical_count = count;
+
+    free(ids);
+    free(core_keys);
+    free(llc_keys);
+
+    qsort(s_cpu, count, sizeof(*s_cpu), Compare_Cpu);
+
+    return 1;
+}
+#endif
+//=============================================================================
+int Topology_Init(void)
+{
+    Topology_Shutdown();
+
+#if defined(_WIN32)
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    if (!Init_Flat_Topology(si.dwNumberOfProcessors)) LOG_AND_RETURN0();
+#elif defined(__linux__)
+    Init_Affinity();
+    if (!Init_Sys_Topology()) {
+        free(s_cpu);
+        s_cpu = NULL;
+        s_physical_count = 0;
+        s_llc_count = 0;
+        if (!Init_Affinity_Topology()) LOG_AND_RETURN0();
+    }
+#else
+    if (!Init_Flat_Topology(1)) LOG_AND_RETURN0();
+#endif
+
+    Log("CPU topology: %d logical, %d physical, %d LLC groups\n", s_logical_count, s_physical_count, s_llc_count);
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+void Topology_Shutdown(void)
+{
+    free(s_cpu);
+    s_cpu = NULL;
+    s_logical_count = 0;
+    s_physical_count = 0;
+    s_llc_count = 0;
+#if defined(__linux__)
+    if (s_affinity) CPU_FREE(s_affinity);
+    s_affinity = NULL;
+#endif
+}
+//-----------------------------------------------------------------------------
+int Topology_Logical_Count(void)
+{
+    return s_logical_count;
+}
+//-----------------------------------------------------------------------------
+int Topology_Physical_Count(void)
+{
+    return s_physical_count;
+}
+//-----------------------------------------------------------------------------
+int Topology_LLC_Count(void)
+{
+    return s_llc_count;
+}
+//-----------------------------------------------------------------------------
+int Topology_Pin_Thread(int worker_index)
+{
+    if (!s_logical_count || worker_index < 0) return 0;
+
+    int os_id = s_cpu[worker_index % s_logical_count].os_id;
+
+#if defined(_WIN32)
+    if (os_id >= (int)(sizeof(DWORD_PTR) * 8)) return 0;
+    return 0 != SetThreadAffinityMask(GetCurrentThread(), ((DWORD_PTR)1) << os_id);
+#elif defined(__linux__)
+    cpu_set_t *set = CPU_ALLOC(os_id + 1);
+    size_t set_size = CPU_ALLOC_SIZE(os_id + 1);
+    if (!set) return 0;
+
+    CPU_ZERO_S(set_size, set);
+    CPU_SET_S(os_id, set_size, set);
+    int res = sched_setaffinity(0, set_size, set);
+    CPU_FREE(set);
+
+    return res == 0;
+#else
+    return 0;
+#endif
+}
+//=============================================================================
@@ -0,0 +1,33 @@
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// CPU topology discovery and thread pinning. On Linux logical processors, their physical cores
+// (SMT siblings) and last-level cache groups are read from /sys/devices/system/cpu. Logical
+// processors are kept in pinning order: one thread per physical core first, cores of the same
+// LLC group next to each other, remaining SMT siblings last. Only processors in the affinity
+// mask of the process are used, so counts and pinning respect taskset and container cpusets.
+
+int Topology_Init(void);
+void Topology_Shutdown(void);
+
+int Topology_Logical_Count(void);
+int Topology_Physical_Count(void);
+int Topology_LLC_Count(void);
+
+// Pins the calling thread to the logical processor assigned to worker_index.
+int Topology_Pin_Thread(int worker_index);
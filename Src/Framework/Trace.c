@@ -0,0 +1,120 @@
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "Trace.h"
+#include "Misc.h"
+#include "SDL.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+//=============================================================================
+typedef struct TRACE_EVENT
+{
+    const char                          *name;
+    Uint64                              begin;
+    Uint64                              end;
+} TRACE_EVENT;
+
+// Padded so the counts of neighbouring threads do not share a cache line
+typedef struct TRACE_THREAD
+{
+    TRACE_EVENT                         *events;
+    Uint64                              count;
+    char                                pad[64 - sizeof(TRACE_EVENT *) - sizeof(Uint64)];
+} TRACE_THREAD;
+//=============================================================================
+static TRACE_THREAD                     *s_thread;
+static int                              s_thread_count;
+static int                              s_events_per_thread;
+static Uint64                           s_start;
+//=============================================================================
+int Trace_Init(int thread_count, int events_per_thread)
+{
+    if (thread_count < 1 || events_per_thread < 1) LOG_AND_RETURN0();
+
+    s_thread = calloc(thread_count, sizeof(*s_thread));
+    if (!s_thread) LOG_AND_RETURN0();
+    s_thread_count = thread_count;
+    s_events_per_thread = events_per_thread;
+
+    for (int i = 0; i < thread_count; ++i) {
+        s_thread[i].events = malloc(events_per_thread * sizeof(TRACE_EVENT));
+        if (!s_thread[i].events) LOG_AND_RETURN0();
+    }
+    s_start = SDL_GetPerformanceCounter();
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+void Trace_Shutdown(void)
+{
+    if (!s_thread) return;
+
+    for (int i = 0; i < s_thread_count; ++i) {
+        free(s_thread[i].events);
+    }
+    free(s_thread);
+    s_thread = NULL;
+    s_thread_count = 0;
+}
+//-----------------------------------------------------------------------------
+Uint64 Trace_End(int thread, const char *name, Uint64 begin)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (!s_thread || thread < 0 || thread >= s_thread_count) return now;
+
+    TRACE_THREAD *t = &s_thread[thread];
+    TRACE_EVENT *event = &t->events[t->count++ % s_events_per_thread];
+    event->name = name;
+    event->begin = begin;
+    event->end = now;
+
+    return now;
+}
+//-----------------------------------------------------------------------------
+int Trace_Write(const char *filename)
+{
+    if (!s_thread) LOG_AND_RETURN0();
+
+    FILE *file = fopen(filename, "w");
+    if (!file) LOG_AND_RETURN0();
+
+    const double us_per_tick = 1000000.0 / SDL_GetPerformanceFrequency();
+    int first = 1;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (int i = 0; i < s_thread_count; ++i) {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+                first ? "" : ",\n", i, i ? "Worker" : "Main", i);
+        first = 0;
+    }
+    for (int i = 0; i < s_thread_count; ++i) {
+        const TRACE_THREAD *t = &s_thread[i];
+        Uint64 begin = t->count > (Uint64)s_events_per_thread ? t->count - s_events_per_thread : 0;
+
+        for (Uint64 j = begin; j < t->count; ++j) {
+            const TRACE_EVENT *event = &t->events[j % s_events_per_thread];
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    event->name, i, (event->begin - s_start) * us_per_tick, (event->end - event->begin) * us_per_tick);
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    if (fclose(file) != 0) LOG_AND_RETURN0();
+
+    return 1;
+}
+//=============================================================================
@@ -0,0 +1,33 @@
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <SDL_stdinc.h>
+
+// Timing markers written to Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev).
+// Every thread owns a ring buffer that keeps its latest events_per_thread markers; the thread
+// index is the job worker index, so no locking is needed as long as Trace_Write is called
+// while no jobs are running.
+
+int Trace_Init(int thread_count, int events_per_thread);
+void Trace_Shutdown(void);
+
+// Records a marker from begin to now on the thread and returns now, so markers can be chained.
+// name must be a string literal or otherwise outlive the trace.
+Uint64 Trace_End(int thread, const char *name, Uint64 begin);
+
+int Trace_Write(const char *filename);
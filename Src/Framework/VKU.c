@@ -17,140 +17,257 @@
 #include "VKU.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "stretchy_buffer.h"
 #include "Misc.h"
 
 //=============================================================================
-int VKU_Create_Buffer_Memory_Pool(
-    VkDevice                   device,
-    VkQueue                    queue,
-    const VkMemoryAllocateInfo *alloc,
-    VKU_BUFFER_MEMORY_POOL     **mempool)
+#define k_Memory_Min_Order 10  // smallest buddy range is 1 KB
+
+// A block either serves one dedicated allocation (tree == NULL) or is split by a buddy
+// allocator. The tree is implicit (node i has children 2i and 2i+1, root is 1) and every node
+// stores the order + 1 of the largest free range below it, 0 when nothing is left.
+struct VKU_MEMORY_BLOCK
 {
-    if (!device || !alloc || !mempool) LOG_AND_RETURN0();
+    VkDeviceMemory                      memory;
+    uint32_t                            memtypeindex;
+    VkDeviceSize                        size;
+    uint32_t                            order;
+    uint8_t                             *tree;
+};
+
+struct VKU_MEMORY_ALLOCATION
+{
+    VkBuffer                            buffer;
+    VkImage                             image;
+    VKU_MEMORY_BLOCK                    *block;
+    VkDeviceSize                        offset;
+    uint32_t                            order;
+};
+//=============================================================================
+static uint32_t Memory_Order(VkDeviceSize size)
+{
+    uint32_t order = 0;
+    while (((VkDeviceSize)1 << (order + k_Memory_Min_Order)) < size) ++order;
+    return order;
+}
+//-----------------------------------------------------------------------------
+static void Buddy_Update_Parents(VKU_MEMORY_BLOCK *block, uint32_t node, uint32_t order)
+{
+    while (node > 1) {
+        node >>= 1;
+        ++order;
 
-    VkDeviceMemory mem;
-    VKU_VR(vkAllocateMemory(device, alloc, NO_ALLOC_CALLBACK, &mem));
+        uint8_t left = block->tree[2 * node];
+        uint8_t right = block->tree[2 * node + 1];
 
-    VKU_BUFFER_MEMORY_POOL *mpool = malloc(sizeof(*mpool));
-    if (!mpool) {
-        if (mem) { vkFreeMemory(device, mem, NO_ALLOC_CALLBACK); mem = VK_NULL_HANDLE; }
-        LOG_AND_RETURN0();
+        // both halves free again: merge them back into one range of this order
+        if (left == order && right == order) block->tree[node] = (uint8_t)(order + 1);
+        else block->tree[node] = left > right ? left : right;
     }
+}
+//-----------------------------------------------------------------------------
+static int Buddy_Alloc(VKU_MEMORY_BLOCK *block, uint32_t order, VkDeviceSize *offset)
+{
+    if (!block->tree || order > block->order || block->tree[1] < order + 1) return 0;
 
-    mpool->device = device;
-    mpool->queue  = queue;
-    mpool->memory = mem;
-    mpool->offset = 0;
-    mpool->size = alloc->allocationSize;
-    mpool->buffers = NULL;
+    uint32_t node = 1;
+    for (uint32_t node_order = block->order; node_order > order; --node_order) {
+        node = block->tree[2 * node] >= order + 1 ? 2 * node : 2 * node + 1;
+    }
+    block->tree[node] = 0;
+    Buddy_Update_Parents(block, node, order);
 
-    *mempool = mpool;
+    uint32_t first = 1u << (block->order - order);
+    *offset = (VkDeviceSize)(node - first) << (order + k_Memory_Min_Order);
 
     return 1;
 }
 //-----------------------------------------------------------------------------
-int VKU_Create_Image_Memory_Pool(
-    VkDevice                   device,
-    VkQueue                    queue,
-    const VkMemoryAllocateInfo *alloc,
-    VKU_IMAGE_MEMORY_POOL      **mempool)
+static void Buddy_Free(VKU_MEMORY_BLOCK *block, VkDeviceSize offset, uint32_t order)
 {
-    if (!device || !alloc || !mempool) LOG_AND_RETURN0();
+    uint32_t first = 1u << (block->order - order);
+    uint32_t node = first + (uint32_t)(offset >> (order + k_Memory_Min_Order));
 
-    VkDeviceMemory mem;
-    VKU_VR(vkAllocateMemory(device, alloc, NO_ALLOC_CALLBACK, &mem));
-
-    VKU_IMAGE_MEMORY_POOL *mpool = malloc(sizeof(*mpool));
-    if (!mpool) {
-        if (mem) { vkFreeMemory(device, mem, NO_ALLOC_CALLBACK); mem = VK_NULL_HANDLE; }
-        LOG_AND_RETURN0();
+    block->tree[node] = (uint8_t)(order + 1);
+    Buddy_Update_Parents(block, node, order);
+}
+//-----------------------------------------------------------------------------
+static VKU_MEMORY_BLOCK *Create_Memory_Block(VKU_MEMORY_POOL *mempool, VkDeviceSize size,
+                                            uint32_t memtypeindex, int dedicated)
+{
+    VKU_MEMORY_BLOCK *block = calloc(1, sizeof(*block));
+    if (!block) return NULL;
+
+    block->memtypeindex = memtypeindex;
+    block->size = size;
+
+    if (!dedicated) {
+        block->order = Memory_Order(size);
+        block->size = (VkDeviceSize)1 << (block->order + k_Memory_Min_Order);
+        block->tree = malloc((size_t)2 << block->order);
+        if (!block->tree) { free(block); return NULL; }
+
+        for (uint32_t order = 0; order <= block->order; ++order) {
+            uint32_t first = 1u << (block->order - order);
+            memset(&block->tree[first], order + 1, first);
+        }
     }
 
-    mpool->device = device;
-    mpool->queue = queue;
-    mpool->memory = mem;
-    mpool->offset = 0;
-    mpool->size = alloc->allocationSize;
-    mpool->images = NULL;
-
-    *mempool = mpool;
+    VkMemoryAllocateInfo alloc = {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, block->size, memtypeindex
+    };
+    if (vkAllocateMemory(mempool->device, &alloc, NO_ALLOC_CALLBACK, &block->memory) != VK_SUCCESS) {
+        free(block->tree);
+        free(block);
+        return NULL;
+    }
+    sb_push(mempool->blocks, block);
 
-    return 1;
+    return block;
 }
 //-----------------------------------------------------------------------------
-int VKU_Free_Buffer_Memory_Pool(VKU_BUFFER_MEMORY_POOL *mempool)
+static void Destroy_Memory_Block(VKU_MEMORY_POOL *mempool, VKU_MEMORY_BLOCK *block)
 {
-    if (!mempool) LOG_AND_RETURN0();
+    for (int i = 0; i < sb_count(mempool->blocks); ++i) {
+        if (mempool->blocks[i] == block) {
+            mempool->blocks[i] = sb_last(mempool->blocks);
+            stb__sbn(mempool->blocks)--;
+            break;
+        }
+    }
+    vkFreeMemory(mempool->device, block->memory, NO_ALLOC_CALLBACK);
+    free(block->tree);
+    free(block);
+}
+//-----------------------------------------------------------------------------
+static int Alloc_Memory(VKU_MEMORY_POOL *mempool, const VkMemoryRequirements *mreq,
+                        uint32_t memtypeindex, VKU_MEMORY_ALLOCATION *allocation)
+{
+    if (!(mreq->memoryTypeBits & (1u << memtypeindex))) LOG_AND_RETURN0();
+
+    VkDeviceSize size = mreq->size;
+    if (size < mreq->alignment) size = mreq->alignment;
+    if (size < mempool->granularity) size = mempool->granularity;
+
+    // large objects (render targets) would waste half a block to rounding, give them their own
+    if (size > mempool->block_size / 2) {
+        allocation->block = Create_Memory_Block(mempool, mreq->size, memtypeindex, 1);
+        if (!allocation->block) LOG_AND_RETURN0();
+        allocation->offset = 0;
+        allocation->order = 0;
+        return 1;
+    }
 
-    sb_free(mempool->buffers);
-    mempool->buffers = NULL;
+    // buddy ranges are naturally aligned to their size, which covers alignment and granularity
+    allocation->order = Memory_Order(size);
+    for (int i = 0; i < sb_count(mempool->blocks); ++i) {
+        VKU_MEMORY_BLOCK *block = mempool->blocks[i];
+        if (block->memtypeindex == memtypeindex &&
+            Buddy_Alloc(block, allocation->order, &allocation->offset)) {
+            allocation->block = block;
+            return 1;
+        }
+    }
 
-    if (mempool->memory) {
-        vkFreeMemory(mempool->device, mempool->memory, NO_ALLOC_CALLBACK);
-        mempool->memory = VK_NULL_HANDLE;
+    VKU_MEMORY_BLOCK *block = Create_Memory_Block(mempool, mempool->block_size, memtypeindex, 0);
+    if (!block) LOG_AND_RETURN0();
+    if (!Buddy_Alloc(block, allocation->order, &allocation->offset)) {
+        Destroy_Memory_Block(mempool, block);
+        LOG_AND_RETURN0();
     }
-    free(mempool);
+    allocation->block = block;
 
     return 1;
 }
-int VKU_Free_Image_Memory_Pool(VKU_IMAGE_MEMORY_POOL *mempool)
+//-----------------------------------------------------------------------------
+// Returns the range of Alloc_Memory, the block goes away with a dedicated allocation.
+static void Release_Memory(VKU_MEMORY_POOL *mempool, const VKU_MEMORY_ALLOCATION *allocation)
 {
-    if (!mempool) LOG_AND_RETURN0();
-
-    sb_free(mempool->images);
-    mempool->images = NULL;
-
+    if (allocation->block->tree) Buddy_Free(allocation->block, allocation->offset, allocation->order);
+    else Destroy_Memory_Block(mempool, allocation->block);
+}
+//-----------------------------------------------------------------------------
+static int Free_Memory(VKU_MEMORY_POOL *mempool, VkBuffer buffer, VkImage image)
+{
+    for (int i = 0; i < sb_count(mempool->allocations); ++i) {
+        VKU_MEMORY_ALLOCATION *allocation = &mempool->allocations[i];
+        if (allocation->buffer != buffer || allocation->image != image) continue;
 
-    if (mempool->memory) { vkFreeMemory(mempool->device, mempool->memory, NO_ALLOC_CALLBACK); mempool->memory = VK_NULL_HANDLE; }
-    free(mempool);
+        Release_Memory(mempool, allocation);
 
-    return 1;
+        *allocation = sb_last(mempool->allocations);
+        stb__sbn(mempool->allocations)--;
+        return 1;
+    }
+    LOG_AND_RETURN0();
 }
 //-----------------------------------------------------------------------------
-int VKU_Alloc_Buffer_Memory(
-    VKU_BUFFER_MEMORY_POOL *mempool,
-    VkDeviceSize            size,
-    VkDeviceSize            alignment,
-    VkDeviceSize           *offset)
+static int Create_Memory_Pool(VkDevice device, VkQueue queue, VkDeviceSize block_size,
+                              VkDeviceSize granularity, VKU_MEMORY_POOL **mempool)
 {
-    if (!mempool || size == 0 || !offset) LOG_AND_RETURN0();
-    if (alignment == 0) alignment = 1;
+    if (!device || !block_size || !mempool) LOG_AND_RETURN0();
 
-    VkDeviceSize r = mempool->offset % alignment;
-    VkDeviceSize offset_change = r > 0 ? alignment - r : 0;
-    if (mempool->offset + offset_change + size > mempool->size) LOG_AND_RETURN0();
+    VKU_MEMORY_POOL *mpool = calloc(1, sizeof(*mpool));
+    if (!mpool) LOG_AND_RETURN0();
 
-    mempool->offset += offset_change;
-    *offset = mempool->offset;
-    mempool->offset += size;
+    mpool->device = device;
+    mpool->queue = queue;
+    mpool->block_size = (VkDeviceSize)1 << (Memory_Order(block_size) + k_Memory_Min_Order);
+    mpool->granularity = granularity;
+
+    *mempool = mpool;
 
     return 1;
 }
 //-----------------------------------------------------------------------------
-int VKU_Alloc_Image_Memory(
-    VKU_IMAGE_MEMORY_POOL *mempool,
-    VkDeviceSize           size,
-    VkDeviceSize           alignment,
-    VkDeviceSize          *offset)
+static int Free_Memory_Pool(VKU_MEMORY_POOL *mempool)
 {
-    if (!mempool || size == 0 || !offset) LOG_AND_RETURN0();
-    if (alignment == 0) alignment = 1;
-
-    VkDeviceSize r = mempool->offset % alignment;
-    VkDeviceSize offset_change = r > 0 ? alignment - r : 0;
-    if (mempool->offset + offset_change + size > mempool->size) LOG_AND_RETURN0();
+    if (!mempool) LOG_AND_RETURN0();
 
-    mempool->offset += offset_change;
-    *offset = mempool->offset;
-    mempool->offset += size;
+    while (sb_count(mempool->blocks)) {
+        Destroy_Memory_Block(mempool, mempool->blocks[0]);
+    }
+    sb_free(mempool->blocks);
+    sb_free(mempool->allocations);
+    free(mempool);
 
     return 1;
 }
+//=============================================================================
+int VKU_Create_Buffer_Memory_Pool(
+    VkDevice                   device,
+    VkQueue                    queue,
+    VkDeviceSize               block_size,
+    VKU_BUFFER_MEMORY_POOL     **mempool)
+{
+    return Create_Memory_Pool(device, queue, block_size, 1, mempool);
+}
+//-----------------------------------------------------------------------------
+int VKU_Create_Image_Memory_Pool(
+    VkDevice                   device,
+    VkQueue                    queue,
+    VkDeviceSize               block_size,
+    VkDeviceSize               granularity,
+    VKU_IMAGE_MEMORY_POOL      **mempool)
+{
+    return Create_Memory_Pool(device, queue, block_size, granularity ? granularity : 1, mempool);
+}
+//-----------------------------------------------------------------------------
+int VKU_Free_Buffer_Memory_Pool(VKU_BUFFER_MEMORY_POOL *mempool)
+{
+    return Free_Memory_Pool(mempool);
+}
+//-----------------------------------------------------------------------------
+int VKU_Free_Image_Memory_Pool(VKU_IMAGE_MEMORY_POOL *mempool)
+{
+    return Free_Memory_Pool(mempool);
+}
 //-----------------------------------------------------------------------------
 int VKU_Alloc_Buffer_Object(VKU_BUFFER_MEMORY_POOL *mempool,
     VkBuffer          buffer,
-    VkDeviceSize     *offset)
+    VkDeviceSize     *offset,
+    uint32_t          memtypeindex)
 {
     if (!mempool || !buffer) LOG_AND_RETURN0();
 
@@ -158,14 +275,17 @@ int VKU_Alloc_Buffer_Object(VKU_BUFFER_MEMORY_POOL *mempool,
     vkGetBufferMemoryRequirements(mempool->device, buffer, &mreq);
 
     if (mreq.size > 0) {
-        VkDeviceSize off;
-        if (!VKU_Alloc_Buffer_Memory(mempool, mreq.size, mreq.alignment, &off))
-            LOG_AND_RETURN0();
+        VKU_MEMORY_ALLOCATION allocation = { 0 };
+        allocation.buffer = buffer;
+        if (!Alloc_Memory(mempool, &mreq, memtypeindex, &allocation)) LOG_AND_RETURN0();
 
-        VKU_VR(vkBindBufferMemory(mempool->device, buffer, mempool->memory, off));
+        if (vkBindBufferMemory(mempool->device, buffer, allocation.block->memory, allocation.offset) != VK_SUCCESS) {
+            Release_Memory(mempool, &allocation);
+            LOG_AND_RETURN0();
+        }
 
-        sb_push(mempool->buffers, buffer);
-        if (offset) *offset = off;
+        sb_push(mempool->allocations, allocation);
+        if (offset) *offset = allocation.offset;
     }
 
     return 1;
@@ -174,33 +294,41 @@ int VKU_Alloc_Buffer_Object(VKU_BUFFER_MEMORY_POOL *mempool,
 int VKU_Alloc_Image_Object(VKU_IMAGE_MEMORY_POOL *mempool,
     VkImage           image,
     VkDeviceSize     *offset,
-	uint32_t          memtypeindex)
+    uint32_t          memtypeindex)
 {
     if (!mempool || !image) LOG_AND_RETURN0();
 
-	VkMemoryRequirements mreq;
-	vkGetImageMemoryRequirements(mempool->device, image, &mreq);
+    VkMemoryRequirements mreq;
+    vkGetImageMemoryRequirements(mempool->device, image, &mreq);
 
     if (mreq.size > 0) {
-        VkDeviceSize off;
-        if (!VKU_Alloc_Image_Memory(mempool, mreq.size, mreq.alignment, &off))
-            LOG_AND_RETURN0();
+        VKU_MEMORY_ALLOCATION allocation = { 0 };
+        allocation.image = image;
+        if (!Alloc_Memory(mempool, &mreq, memtypeindex, &allocation)) LOG_AND_RETURN0();
 
-		VkMemoryAllocateInfo mem_alloc;
-		mem_alloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		mem_alloc.pNext = NULL;
-		mem_alloc.allocationSize = mreq.size;
-		mem_alloc.memoryTypeIndex = memtypeindex;
-
-		VKU_VR(vkAllocateMemory(mempool->device, &mem_alloc, NULL, &mempool->memory));
-		VKU_VR(vkBindImageMemory(mempool->device, image, mempool->memory, 0));
+        if (vkBindImageMemory(mempool->device, image, allocation.block->memory, allocation.offset) != VK_SUCCESS) {
+            Release_Memory(mempool, &allocation);
+            LOG_AND_RETURN0();
+        }
 
-        sb_push(mempool->images, image);
-        if (offset) *offset = off;
+        sb_push(mempool->allocations, allocation);
+        if (offset) *offset = allocation.offset;
     }
 
     return 1;
 }
+//-----------------------------------------------------------------------------
+int VKU_Free_Buffer_Object(VKU_BUFFER_MEMORY_POOL *mempool, VkBuffer buffer)
+{
+    if (!mempool || !buffer) LOG_AND_RETURN0();
+    return Free_Memory(mempool, buffer, VK_NULL_HANDLE);
+}
+//-----------------------------------------------------------------------------
+int VKU_Free_Image_Object(VKU_IMAGE_MEMORY_POOL *mempool, VkImage image)
+{
+    if (!mempool || !image) LOG_AND_RETURN0();
+    return Free_Memory(mempool, VK_NULL_HANDLE, image);
+}
 //=============================================================================
 int VKU_Load_Shader(VkDevice device,
     const char *filename,
@@ -238,6 +366,99 @@ int VKU_Load_Shader(VkDevice device,
     return 1;
 }
 //=============================================================================
+// The driver validates the blob too, but a blob written by another driver or device must not
+// even be handed to it, so the header (VkPipelineCacheHeaderVersionOne) is checked here.
+static int Is_Pipeline_Cache_Compatible(VkPhysicalDevice gpu, const unsigned char *data, size_t size)
+{
+    if (size < 16 + VK_UUID_SIZE) return 0;
+
+    uint32_t header[4];
+    memcpy(header, data, sizeof(header));
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(gpu, &props);
+
+    return header[0] >= 16 + VK_UUID_SIZE && header[0] <= size &&
+           header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header[2] == props.vendorID &&
+           header[3] == props.deviceID &&
+           memcmp(data + 16, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+//-----------------------------------------------------------------------------
+int VKU_Load_Pipeline_Cache(VkDevice device,
+    VkPhysicalDevice gpu,
+    const char       *filename,
+    VkPipelineCache  *cache,
+    size_t           *loaded_size)
+{
+    if (!device || !gpu || !filename || !cache) LOG_AND_RETURN0();
+
+    unsigned char *data = NULL;
+    size_t size = 0;
+
+    FILE *fp = fopen(filename, "rb");
+    if (fp) {
+        fseek(fp, 0, SEEK_END);
+        long file_size = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+
+        if (file_size > 0 && (data = malloc(file_size))) {
+            size = fread(data, 1, file_size, fp);
+        }
+        fclose(fp);
+    }
+    if (data && !Is_Pipeline_Cache_Compatible(gpu, data, size)) {
+        free(data);
+        data = NULL;
+    }
+    if (!data) size = 0;
+
+    const VkPipelineCacheCreateInfo cache_info = {
+        VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO, NULL, 0, size, data
+    };
+    VkResult res = vkCreatePipelineCache(device, &cache_info, NO_ALLOC_CALLBACK, cache);
+    free(data);
+    if (res != VK_SUCCESS) LOG_AND_RETURN0();
+
+    if (loaded_size) *loaded_size = size;
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+int VKU_Save_Pipeline_Cache(VkDevice device,
+    VkPipelineCache  cache,
+    const char       *filename,
+    size_t           *saved_size)
+{
+    if (!device || !cache || !filename) LOG_AND_RETURN0();
+
+    size_t size = 0;
+    VKU_VR(vkGetPipelineCacheData(device, cache, &size, NULL));
+
+    unsigned char *data = malloc(size);
+    if (!data) LOG_AND_RETURN0();
+
+    VkResult res = vkGetPipelineCacheData(device, cache, &size, data);
+    if (res != VK_SUCCESS) {
+        free(data);
+        LOG_AND_RETURN0();
+    }
+
+    FILE *fp = fopen(filename, "wb");
+    if (!fp) {
+        free(data);
+        LOG_AND_RETURN0();
+    }
+    size_t written = fwrite(data, 1, size, fp);
+    fclose(fp);
+    free(data);
+    if (written != size) LOG_AND_RETURN0();
+
+    if (saved_size) *saved_size = size;
+
+    return 1;
+}
+//=============================================================================
 // Define function pointers
 #define VK_FUNCTION(func) PFN_##func func = NULL
 #define _VK_ALL_FUNCTIONS
@@ -259,9 +480,11 @@ int VK__Load_Instance_Api(VkInstance instance)
 {
     // Load function pointers
 #define VK_FUNCTION(func) if (!(func = (PFN_##func)vkGetInstanceProcAddr(instance, #func))) { LOG_AND_RETURN0(); }
+#define VK_WSI_FUNCTION(func) func = (PFN_##func)vkGetInstanceProcAddr(instance, #func)
 #define _VK_INSTANCE_FUNCTIONS
 #include "vkFuncList.h"
 #undef _VK_INSTANCE_FUNCTIONS
+#undef VK_WSI_FUNCTION
 #undef VK_FUNCTION
     return 1;
 }
@@ -269,9 +492,11 @@ int VK__Load_Device_Api(VkDevice device)
 {
     // Load function pointers
 #define VK_FUNCTION(func) if (!(func = (PFN_##func)vkGetDeviceProcAddr(device, #func))) { LOG_AND_RETURN0(); }
+#define VK_WSI_FUNCTION(func) func = (PFN_##func)vkGetDeviceProcAddr(device, #func)
 #define _VK_DEVICE_FUNCTIONS
 #include "vkFuncList.h"
 #undef _VK_DEVICE_FUNCTIONS
+#undef VK_WSI_FUNCTION
 #undef VK_FUNCTION
     return 1;
 }
@@ -39,26 +39,29 @@
 #define VKU_DESTROY(f, obj) if (obj) { f(s_gpu_device, obj, NO_ALLOC_CALLBACK); obj = VK_NULL_HANDLE; }
 #define VKU_VR(f) { VkResult _r = (f); if (_r < 0) { Log("%s failed with result: 0x%x", #f, _r); LOG_AND_RETURN0();} }
 
-typedef struct VKU_BUFFER_MEMORY_POOL
+// Device memory pools. A pool carves VkDeviceMemory blocks of block_size, created on demand per
+// memory type, with a buddy allocator: power of two ranges, naturally aligned, freed ranges
+// merge with their buddy. Objects larger than half a block get a dedicated allocation. Buffers
+// and images never share a block, image pools also pad to bufferImageGranularity so linear and
+// optimal images can live side by side.
+typedef struct VKU_MEMORY_BLOCK VKU_MEMORY_BLOCK;
+typedef struct VKU_MEMORY_ALLOCATION VKU_MEMORY_ALLOCATION;
+
+typedef struct VKU_MEMORY_POOL
 {
-  VkDevice       device;
-  VkQueue        queue;
-  VkDeviceMemory memory;
-  VkDeviceSize   size;
-  VkDeviceSize   offset;
-  VkBuffer      *buffers;
-} VKU_BUFFER_MEMORY_POOL;
-
-typedef struct VKU_IMAGE_MEMORY_POOL
-{
-    VkDevice       device;
-    VkQueue        queue;
-    VkDeviceMemory memory;
-    VkDeviceSize   size;
-    VkDeviceSize   offset;
-    VkImage       *images;
-} VKU_IMAGE_MEMORY_POOL;
-
+  VkDevice               device;
+  VkQueue                queue;
+  VkDeviceSize           block_size;
+  VkDeviceSize           granularity;
+  VKU_MEMORY_BLOCK       **blocks;
+  VKU_MEMORY_ALLOCATION  *allocations;
+} VKU_MEMORY_POOL;
+
+typedef VKU_MEMORY_POOL VKU_BUFFER_MEMORY_POOL;
+typedef VKU_MEMORY_POOL VKU_IMAGE_MEMORY_POOL;
+
+// present_mode falls back to the first IMMEDIATE or FIFO mode of the surface when unsupported
+// or VK_PRESENT_MODE_MAX_ENUM_KHR.
 int VKU_Create_Device(void          *hwnd,
                       int          width,
                       int          height,
@@ -69,50 +72,67 @@ int VKU_Create_Device(void          *hwnd,
                       VkQueue      *queue,
                       VkImage      *images,
                       VkSwapchainKHR       *swap_chain,
+                      VkPresentModeKHR     present_mode,
                       VkPhysicalDevice     *gpu);
 
+// No surface or swapchain extensions, for rendering into offscreen images only.
+int VKU_Create_Headless_Device(uint32_t         *queue_family_index,
+                               VkDevice         *device,
+                               VkQueue          *queue,
+                               VkPhysicalDevice *gpu);
+
 void VKU_Quit(void);
 
-int VKU_Present(uint32_t *image_indice);
+int VKU_Present(uint32_t *image_indice, VkSemaphore wait_semaphore);
 
 int VKU_Create_Buffer_Memory_Pool(VkDevice                   device,
                                   VkQueue                    queue,
-                                  const VkMemoryAllocateInfo *alloc,
+                                  VkDeviceSize               block_size,
                                   VKU_BUFFER_MEMORY_POOL     **mempool);
 
 int VKU_Create_Image_Memory_Pool(VkDevice                   device,
                                  VkQueue                    queue,
-                                 const VkMemoryAllocateInfo *alloc,
+                                 VkDeviceSize               block_size,
+                                 VkDeviceSize               granularity,
                                  VKU_IMAGE_MEMORY_POOL      **mempool);
 
 int VKU_Free_Buffer_Memory_Pool(VKU_BUFFER_MEMORY_POOL *mempool);
 
 int VKU_Free_Image_Memory_Pool(VKU_IMAGE_MEMORY_POOL *mempool);
 
-int VKU_Alloc_Buffer_Memory(VKU_BUFFER_MEMORY_POOL *mempool,
-                            VkDeviceSize           size,
-                            VkDeviceSize           alignment,
-                            VkDeviceSize           *offset);
-
-int VKU_Alloc_Image_Memory(VKU_IMAGE_MEMORY_POOL *mempool,
-                           VkDeviceSize          size,
-                           VkDeviceSize          alignment,
-                           VkDeviceSize          *offset);
-
 int VKU_Alloc_Buffer_Object(VKU_BUFFER_MEMORY_POOL *objpool,
                             VkBuffer               buffer,
-                            VkDeviceSize           *offset);
+                            VkDeviceSize           *offset,
+                            uint32_t               memtypeindex);
 
 int VKU_Alloc_Image_Object(VKU_IMAGE_MEMORY_POOL *objpool,
                            VkImage               image,
                            VkDeviceSize          *offset,
                            uint32_t              memtypeindex);
 
+// Returns the object's range to its block, the object must no longer be in use by the GPU.
+int VKU_Free_Buffer_Object(VKU_BUFFER_MEMORY_POOL *objpool, VkBuffer buffer);
+
+int VKU_Free_Image_Object(VKU_IMAGE_MEMORY_POOL *objpool, VkImage image);
+
 
 int VKU_Load_Shader(VkDevice        device,
                     const char      *filename,
                     VkShaderModule  *shaderModule);
 
+// Creates a pipeline cache seeded from filename if it was written by the same driver and
+// device; a missing, stale or foreign file yields an empty cache. loaded_size is 0 then.
+int VKU_Load_Pipeline_Cache(VkDevice         device,
+                            VkPhysicalDevice gpu,
+                            const char       *filename,
+                            VkPipelineCache  *cache,
+                            size_t           *loaded_size);
+
+int VKU_Save_Pipeline_Cache(VkDevice         device,
+                            VkPipelineCache  cache,
+                            const char       *filename,
+                            size_t           *saved_size);
+
 int VK__Load_Global_Api(void *(*Loader)(const char *));
 
 int VK__Load_Device_Api(VkDevice device);
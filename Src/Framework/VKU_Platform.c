@@ -17,16 +17,18 @@
 #include "VKU.h"
 #include "SDL.h"
 
-#ifdef __ANDROID__
-#   include <dlfcn.h>
-#else
+#ifdef _WIN32
 #   include <windows.h>
+#else
+#   include <dlfcn.h>
 #endif
 
 //=============================================================================
 typedef void               *(*PFNLoader)(const char *func);
 static void                *Loader(const char *func);
+#ifdef _WIN32
 static int                 Load_WsiWin_Entry_Points(PFNLoader);
+#endif
 static int                 Init(void *hwnd, int width, int height, VkBool32 windowed, uint32_t image_count, VkImage *images);
 static void                Deinit(void);
 static int                 Init_Instance(void);
@@ -43,16 +45,18 @@ static uint32_t            s_queue_family_index = 0;
 static VkSwapchainKHR      s_swap_chain = { VK_NULL_HANDLE };
 static int                 s_back_buffer = 0;
 static VkSurfaceKHR        s_surface = VK_NULL_HANDLE;
+static int                 s_headless = 0;
+static VkPresentModeKHR    s_present_mode = VK_PRESENT_MODE_MAX_ENUM_KHR;
 #if ENABLE_DEBUG_REPORT
 static VkDebugReportCallbackEXT s_callback = VK_NULL_HANDLE;
 #endif
 //=============================================================================
 static void *Loader(const char *func)
 {
-#ifdef __ANDROID__
-    return dlsym(s_vk_dll, func);
-#else
+#ifdef _WIN32
     return GetProcAddress(s_vk_dll, func);
+#else
+    return dlsym(s_vk_dll, func);
 #endif
 }
 //=============================================================================
@@ -67,15 +71,20 @@ VkBool32 VKAPI_CALL DebugReportCallback(VkDebugReportFlagsEXT flags, VkDebugRepo
 static int Init(void *hwnd, int width, int height, VkBool32 windowed,
                 uint32_t image_count, VkImage *images)
 {
-#ifdef __ANDROID__
+#if defined(__ANDROID__)
     s_vk_dll = dlopen("libigvk.so", RTLD_NOW);
-#else
+#elif defined(_WIN32)
     s_vk_dll = LoadLibrary("vulkan-1.dll");
-    if (!s_vk_dll) {
+    if (!s_vk_dll && hwnd) {
         MessageBox((HWND)hwnd, "Failed to load Vulkan loader.", "Error", MB_ICONERROR);
     }
+#else
+    s_vk_dll = dlopen("libvulkan.so.1", RTLD_NOW);
 #endif
-    if (!s_vk_dll) return 0;
+    if (!s_vk_dll) {
+        Log("Failed to load Vulkan loader\n");
+        return 0;
+    }
 
     if (!VK__Load_Global_Api(Loader)) return 0;
     if (!Init_Instance()) return 0;
@@ -85,6 +94,7 @@ static int Init(void *hwnd, int width, int height, VkBool32 windowed,
 
     vkGetDeviceQueue(s_device, s_queue_family_index, 0, &s_queue);
 
+    if (s_headless) return 1;
     if (!Init_Framebuffer(hwnd, width, height, windowed, image_count, images))
         return 0;
 
@@ -115,10 +125,10 @@ static void Deinit(void)
         s_instance = VK_NULL_HANDLE;
     }
     if (s_vk_dll) {
-#ifdef __ANDROID__
-        dlclose(s_vk_dll);
-#else
+#ifdef _WIN32
         FreeLibrary(s_vk_dll);
+#else
+        dlclose(s_vk_dll);
 #endif
         s_vk_dll = NULL;
     }
@@ -136,12 +146,25 @@ static int Init_Instance(void)
     app_info.apiVersion         = VK_API_VERSION_1_0;
 
     const char* instance_extensions[] = {
+#if ENABLE_DEBUG_REPORT
+        VK_EXT_DEBUG_REPORT_EXTENSION_NAME,
+#endif
+#ifdef VK_KHR_PLATFORM_SPECIFIC_SURFACE_EXTENSION_NAME
         VK_KHR_SURFACE_EXTENSION_NAME,
         VK_KHR_PLATFORM_SPECIFIC_SURFACE_EXTENSION_NAME,
-#if ENABLE_DEBUG_REPORT
-        VK_EXT_DEBUG_REPORT_EXTENSION_NAME
 #endif
+        NULL
     };
+    // headless mode enables no surface extensions, without a platform surface it is the only mode
+    uint32_t instance_extension_count = SDL_arraysize(instance_extensions) - 1;
+#ifdef VK_KHR_PLATFORM_SPECIFIC_SURFACE_EXTENSION_NAME
+    if (s_headless) instance_extension_count -= 2;
+#else
+    if (!s_headless) {
+        Log("No window surface on this platform, only headless mode is supported\n");
+        LOG_AND_RETURN0();
+    }
+#endif
 
     VkInstanceCreateInfo instance_info = { 0 };
     instance_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -150,8 +173,8 @@ static int Init_Instance(void)
     instance_info.pApplicationInfo = &app_info;
     instance_info.enabledLayerCount = 0;
     instance_info.ppEnabledLayerNames = NULL;
-    instance_info.enabledExtensionCount = SDL_arraysize(instance_extensions);
-    instance_info.ppEnabledExtensionNames = instance_extensions;
+    instance_info.enabledExtensionCount = instance_extension_count;
+    instance_info.ppEnabledExtensionNames = instance_extension_count ? instance_extensions : NULL;
 
     VKU_VR(vkCreateInstance(&instance_info, NO_ALLOC_CALLBACK, &s_instance));
     return 1;
@@ -199,8 +222,14 @@ static int Init_Device(void)
     queue_info.queueCount = 1;
     queue_info.pQueuePriorities = &queuePriority;
 
+    VkPhysicalDeviceFeatures supported_features;
+    vkGetPhysicalDeviceFeatures(s_gpu, &supported_features);
+
     VkPhysicalDeviceFeatures feature_info = { 0 };
     feature_info.vertexPipelineStoresAndAtomics = VK_TRUE;
+    feature_info.multiDrawIndirect = supported_features.multiDrawIndirect;
+    // BC texture containers are only sampled when this is set, otherwise they fall back to PNG
+    feature_info.textureCompressionBC = supported_features.textureCompressionBC;
 
     VkDeviceCreateInfo device_info = { 0 };
     device_info.sType                       = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -210,8 +239,8 @@ static int Init_Device(void)
     device_info.pQueueCreateInfos           = &queue_info;
     device_info.enabledLayerCount           = 0;
     device_info.ppEnabledLayerNames         = NULL;
-    device_info.enabledExtensionCount       = SDL_arraysize(extensions);
-    device_info.ppEnabledExtensionNames     = extensions;
+    device_info.enabledExtensionCount       = s_headless ? 0 : SDL_arraysize(extensions);
+    device_info.ppEnabledExtensionNames     = s_headless ? NULL : extensions;
     device_info.pEnabledFeatures            = &feature_info;
 
     VKU_VR(vkCreateDevice(s_gpu, &device_info, NO_ALLOC_CALLBACK, &s_device));
@@ -224,6 +253,11 @@ static int Init_Framebuffer(void *hwnd, int width, int height, VkBool32 windowed
 {
     VkFormat image_format = VK_FORMAT_UNDEFINED;
 
+    if (!vkCreateSwapchainKHR || !vkGetPhysicalDeviceSurfaceSupportKHR) {
+        Log("Surface or swapchain entry points not found\n");
+        LOG_AND_RETURN0();
+    }
+
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
     const VkAndroidSurfaceCreateInfoKHR androidSurfaceCreateInfo = {
         VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR, NULL, 0, hwnd
@@ -295,7 +329,17 @@ static int Init_Framebuffer(void *hwnd, int width, int height, VkBool32 windowed
     VkPresentModeKHR *present_modes = (VkPresentModeKHR *)malloc(sizeof(VkPresentModeKHR) * present_mode_count);
     VKU_VR(vkGetPhysicalDeviceSurfacePresentModesKHR(s_gpu, s_surface, &present_mode_count, present_modes));
 
-    for (uint32_t i = 0; i< present_mode_count; i++) {
+    for (uint32_t i = 0; i < present_mode_count && s_present_mode != VK_PRESENT_MODE_MAX_ENUM_KHR; i++) {
+        if (present_modes[i] == s_present_mode) {
+            chosen_present_mode = &present_modes[i];
+            break;
+        }
+    }
+    if (!chosen_present_mode && s_present_mode != VK_PRESENT_MODE_MAX_ENUM_KHR) {
+        Log("Requested present mode %d not supported by the surface, will use IMMEDIATE or FIFO\n", s_present_mode);
+    }
+
+    for (uint32_t i = 0; i < present_mode_count && !chosen_present_mode; i++) {
         if (present_modes[i] == VK_PRESENT_MODE_IMMEDIATE_KHR || present_modes[i] == VK_PRESENT_MODE_FIFO_KHR) {
             chosen_present_mode = &present_modes[i];
             break;
@@ -310,6 +354,7 @@ static int Init_Framebuffer(void *hwnd, int width, int height, VkBool32 windowed
         Log("No supported present modes\n");
         LOG_AND_RETURN0();
     }
+    Log("Present mode: %d\n", *chosen_present_mode);
 
     // Create VkSwapChain
     VkSwapchainCreateInfoKHR create_info = { 0 };
@@ -357,8 +402,10 @@ int VKU_Create_Device(void             *hwnd,
                       VkQueue          *queue,
                       VkImage          *images,
                       VkSwapchainKHR   *swap_chain,
+                      VkPresentModeKHR present_mode,
                       VkPhysicalDevice *gpu)
 {
+    s_present_mode = present_mode;
     if (!Init(hwnd, width, height, windowed, win_image_count, images)) {
         Deinit();
         return 0;
@@ -373,19 +420,38 @@ int VKU_Create_Device(void             *hwnd,
     return 1;
 }
 //-----------------------------------------------------------------------------
+int VKU_Create_Headless_Device(uint32_t         *queue_family_index,
+                               VkDevice         *device,
+                               VkQueue          *queue,
+                               VkPhysicalDevice *gpu)
+{
+    s_headless = 1;
+    if (!Init(NULL, 0, 0, VK_TRUE, 0, NULL)) {
+        Deinit();
+        return 0;
+    }
+
+    *device = s_device;
+    *queue = s_queue;
+    *gpu = s_gpu;
+    *queue_family_index = s_queue_family_index;
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
 void VKU_Quit(void)
 {
     Deinit();
 }
 //-----------------------------------------------------------------------------
-int VKU_Present(uint32_t *image_indice)
+int VKU_Present(uint32_t *image_indice, VkSemaphore wait_semaphore)
 {
     VkResult result[1] = { 0 };
     VkPresentInfoKHR present_info = { 0 };
     present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     present_info.pNext = NULL;
-    present_info.waitSemaphoreCount = 0;
-    present_info.pWaitSemaphores = NULL;
+    present_info.waitSemaphoreCount = wait_semaphore ? 1 : 0;
+    present_info.pWaitSemaphores = wait_semaphore ? &wait_semaphore : NULL;
     present_info.swapchainCount = 1;
     present_info.pSwapchains = &s_swap_chain;
     present_info.pImageIndices = image_indice;
@@ -14,6 +14,14 @@
 // limitations under the License.
 /////////////////////////////////////////////////////////////////////////////////////////////
 
+// Surface and swapchain entry points go through VK_WSI_FUNCTION when the includer defines it,
+// they are not loaded in headless mode where those extensions are not enabled.
+#ifdef VK_WSI_FUNCTION
+#define VK_WSI(func) VK_WSI_FUNCTION(func)
+#else
+#define VK_WSI(func) VK_FUNCTION(func)
+#endif
+
 #if defined(_VK_GLOBAL_FUNCTIONS) || defined(_VK_ALL_FUNCTIONS)
 VK_FUNCTION(vkCreateInstance);
 VK_FUNCTION(vkEnumerateInstanceExtensionProperties);
@@ -37,27 +45,27 @@ VK_FUNCTION(vkEnumerateDeviceExtensionProperties);
 VK_FUNCTION(vkEnumerateDeviceLayerProperties);
 
 // VK_KHR_surface
-VK_FUNCTION(vkDestroySurfaceKHR);
-VK_FUNCTION(vkGetPhysicalDeviceSurfaceSupportKHR);
-VK_FUNCTION(vkGetPhysicalDeviceSurfaceCapabilitiesKHR);
-VK_FUNCTION(vkGetPhysicalDeviceSurfaceFormatsKHR);
-VK_FUNCTION(vkGetPhysicalDeviceSurfacePresentModesKHR);
+VK_WSI(vkDestroySurfaceKHR);
+VK_WSI(vkGetPhysicalDeviceSurfaceSupportKHR);
+VK_WSI(vkGetPhysicalDeviceSurfaceCapabilitiesKHR);
+VK_WSI(vkGetPhysicalDeviceSurfaceFormatsKHR);
+VK_WSI(vkGetPhysicalDeviceSurfacePresentModesKHR);
 
 #ifdef VK_USE_PLATFORM_WIN32_KHR
 // VK_KHR_win32_surface
-VK_FUNCTION(vkCreateWin32SurfaceKHR);
-VK_FUNCTION(vkGetPhysicalDeviceWin32PresentationSupportKHR);
+VK_WSI(vkCreateWin32SurfaceKHR);
+VK_WSI(vkGetPhysicalDeviceWin32PresentationSupportKHR);
 #endif
 
 #ifdef VK_USE_PLATFORM_XCB_KHR
 // VK_KHR_xcb_surface
-VK_FUNCTION(vkCreateXcbSurfaceKHR)
-VK_FUNCTION(vkGetPhysicalDeviceXcbPresentationSupportKHR);
+VK_WSI(vkCreateXcbSurfaceKHR)
+VK_WSI(vkGetPhysicalDeviceXcbPresentationSupportKHR);
 #endif
 
 #ifdef VK_USE_PLATFORM_ANDROID_KHR
 // VK_KHR_android_surface
-VK_FUNCTION(vkCreateAndroidSurfaceKHR);
+VK_WSI(vkCreateAndroidSurfaceKHR);
 #endif
 
 #if ENABLE_DEBUG_REPORT
@@ -183,10 +191,12 @@ VK_FUNCTION(vkCmdExecuteCommands);
 VK_FUNCTION(vkCmdPushConstants);
 
 // VK_KHR_swapchain
-VK_FUNCTION(vkCreateSwapchainKHR);
-VK_FUNCTION(vkDestroySwapchainKHR);
-VK_FUNCTION(vkGetSwapchainImagesKHR);
-VK_FUNCTION(vkAcquireNextImageKHR);
-VK_FUNCTION(vkQueuePresentKHR);
+VK_WSI(vkCreateSwapchainKHR);
+VK_WSI(vkDestroySwapchainKHR);
+VK_WSI(vkGetSwapchainImagesKHR);
+VK_WSI(vkAcquireNextImageKHR);
+VK_WSI(vkQueuePresentKHR);
+
+#endif
 
-#endif
\ No newline at end of file
+#undef VK_WSI
@@ -0,0 +1,468 @@
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "Particle_CPU.h"
+#include "Misc.h"
+#include "Jobs.h"
+#include <math.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PARTICLE_CPU_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_SSE41
+#define TARGET_AVX2
+#else
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Cephes sinf/cosf reduction and polynomials, the same on every kernel
+#define k_FOPI 1.27323954473516f
+#define k_DP1 0.78515625f
+#define k_DP2 2.4187564849853515625e-4f
+#define k_DP3 3.77489497744594108e-8f
+#define k_Cos_P0 2.443315711809948e-5f
+#define k_Cos_P1 -1.388731625493765e-3f
+#define k_Cos_P2 4.166664568298827e-2f
+#define k_Sin_P0 -1.9515295891e-4f
+#define k_Sin_P1 8.3321608736e-3f
+#define k_Sin_P2 -1.6666654611e-1f
+#define k_Rnd_Scale 2.3283064365387e-10f
+//=============================================================================
+typedef void (*KERNEL_FUNC)(const uint32_t *seeds, int count, const float *m, float *result);
+
+typedef struct PARTICLE_CPU_JOB
+{
+    const uint32_t                      *seeds;
+    int                                 count;
+    int                                 job_count;
+    const float                         *m;
+    float                               *result;
+} PARTICLE_CPU_JOB;
+//=============================================================================
+static KERNEL_FUNC                      s_kernel;
+static const char                       *s_kernel_name;
+//=============================================================================
+static float Rnd_Float(uint32_t *rnd)
+{
+    RND_GEN(*rnd);
+    return (float)*rnd * k_Rnd_Scale;
+}
+//-----------------------------------------------------------------------------
+void Particle_CPU_Transform(uint32_t seed, float palette_factor, float transform[16])
+{
+    uint32_t rnd = seed;
+    float t0[3], s0[3], r0[3], t1[3], s1[3], r1[3];
+
+    for (int i = 0; i < 3; ++i) t0[i] = -1.3f + 2.6f * Rnd_Float(&rnd);
+    for (int i = 0; i < 3; ++i) s0[i] = 0.8f + 0.2f * Rnd_Float(&rnd);
+    for (int i = 0; i < 3; ++i) r0[i] = 1.57079632679f * Rnd_Float(&rnd);
+    for (int i = 0; i < 3; ++i) t1[i] = -1.3f + 2.6f * Rnd_Float(&rnd);
+    for (int i = 0; i < 3; ++i) s1[i] = 0.8f + 0.2f * Rnd_Float(&rnd);
+    for (int i = 0; i < 3; ++i) r1[i] = 1.57079632679f * Rnd_Float(&rnd);
+
+    const float ch0 = cosf(r0[0]), sh0 = sinf(r0[0]);
+    const float cp0 = cosf(r0[1]), sp0 = sinf(r0[1]);
+    const float cb0 = cosf(r0[2]), sb0 = sinf(r0[2]);
+    const float ch1 = cosf(r1[0]), sh1 = sinf(r1[0]);
+    const float cp1 = cosf(r1[1]), sp1 = sinf(r1[1]);
+    const float cb1 = cosf(r1[2]), sb1 = sinf(r1[2]);
+
+    const float tt = palette_factor;
+    const float tt0 = 1.0f - tt;
+
+    transform[0] = (ch0 * cb0 + sh0 * sp0 * sb0 * s0[0]) * tt0 + (ch1 * cb1 + sh1 * sp1 * sb1 * s1[0]) * tt;
+    transform[1] = (sb0 * cp0) * tt0 + (sb1 * cp1) * tt;
+    transform[2] = (-sh0 * cb0 + ch0 * sp0 * sb0) * tt0 + (-sh1 * cb1 + ch1 * sp1 * sb1) * tt;
+    transform[3] = 0.0f;
+    transform[4] = (-ch0 * sb0 + sh0 * sp0 * cb0) * tt0 + (-ch1 * sb1 + sh1 * sp1 * cb1) * tt;
+    transform[5] = (cb0 * cp0 * s0[1]) * tt0 + (cb1 * cp1 * s1[1]) * tt;
+    transform[6] = (sb0 * sh0 + ch0 * sp0 * cb0) * tt0 + (sb1 * sh1 + ch1 * sp1 * cb1) * tt;
+    transform[7] = 0.0f;
+    transform[8] = (sh0 * cp0) * tt0 + (sh1 * cp1) * tt;
+    transform[9] = (-sp0) * tt0 + (-sp1) * tt;
+    transform[10] = (ch0 * cp0 * s0[2]) * tt0 + (ch1 * cp1 * s1[2]) * tt;
+    transform[11] = 0.0f;
+    transform[12] = t0[0] * tt0 + t1[0] * tt;
+    transform[13] = t0[1] * tt0 + t1[1] * tt;
+    transform[14] = t0[2] * tt0 + t1[2] * tt;
+    transform[15] = 1.0f;
+}
+//=============================================================================
+// Scalar mirror of Sin_Cos_SSE41, bit operations included, so the kernel tails match.
+static void Sin_Cos(float x, float *s, float *c)
+{
+    union { float f; uint32_t u; } v, rs, rc;
+
+    v.f = x;
+    uint32_t sign_sin = v.u & 0x80000000u;
+    v.u &= 0x7fffffffu;
+    x = v.f;
+
+    // cvttps yields 0x80000000 for out of range and NaN inputs
+    float q = x * k_FOPI;
+    uint32_t j = q < 2147483648.0f ? (uint32_t)(int32_t)q : 0x80000000u;
+    j = (j + 1) & ~1u;
+    float y = (float)(int32_t)j;
+
+    sign_sin ^= (j & 4) << 29;
+    uint32_t sign_cos = (~(j - 2) & 4) << 29;
+    int poly = (j & 2) == 0;
+
+    x = x - y * k_DP1;
+    x = x - y * k_DP2;
+    x = x - y * k_DP3;
+    float z = x * x;
+
+    float pc = k_Cos_P0;
+    pc = pc * z + k_Cos_P1;
+    pc = pc * z + k_Cos_P2;
+    pc = pc * z;
+    pc = pc * z;
+    pc = pc - z * 0.5f;
+    pc = pc + 1.0f;
+
+    float ps = k_Sin_P0;
+    ps = ps * z + k_Sin_P1;
+    ps = ps * z + k_Sin_P2;
+    ps = ps * z;
+    ps = ps * x;
+    ps = ps + x;
+
+    rs.f = poly ? ps : pc;
+    rc.f = poly ? pc : ps;
+    rs.u ^= sign_sin;
+    rc.u ^= sign_cos;
+    *s = rs.f;
+    *c = rc.f;
+}
+//-----------------------------------------------------------------------------
+static void Evaluate_Scalar(const uint32_t *seeds, int count, const float *m, float *result)
+{
+    for (int i = 0; i < count; ++i) {
+        uint32_t rnd = seeds[i];
+        float x = Rnd_Float(&rnd);
+        float y = Rnd_Float(&rnd);
+        float z = Rnd_Float(&rnd);
+        float c = 0.0f;
+
+        for (int k = 0; k < 8; ++k) {
+            float tx = m[0] * x + m[4] * y + m[8] * z + m[12];
+            float ty = m[1] * x + m[5] * y + m[9] * z + m[13];
+            float tz = m[2] * x + m[6] * y + m[10] * z + m[14];
+
+            // w stays 1 and is part of the length, as in the shader
+            float radius = sqrtf(tx * tx + ty * ty + tz * tz + 1.0f);
+            float theta = ty * (1.0f / tx);
+            float s, co, s_theta, c_theta;
+            Sin_Cos(theta - radius, &s, &co);
+            Sin_Cos(theta, &s_theta, &c_theta);
+
+            x = radius * co;
+            y = radius * s;
+            z = tz;
+            c += 0.1f * s_theta;
+        }
+
+        result[i * 4 + 0] = x;
+        result[i * 4 + 1] = y;
+        result[i * 4 + 2] = z;
+        result[i * 4 + 3] = c;
+    }
+}
+//=============================================================================
+#if defined(PARTICLE_CPU_X86)
+TARGET_SSE41 static __inline __m128 Rnd_Float_SSE41(__m128i *rnd)
+{
+    *rnd = _mm_add_epi32(_mm_mullo_epi32(*rnd, _mm_set1_epi32(196314165)), _mm_set1_epi32(907633515));
+
+    // exact hi * 65536 + lo rounds once, like the scalar unsigned conversion
+    __m128 hi = _mm_cvtepi32_ps(_mm_srli_epi32(*rnd, 16));
+    __m128 lo = _mm_cvtepi32_ps(_mm_and_si128(*rnd, _mm_set1_epi32(0xffff)));
+    __m128 f = _mm_add_ps(_mm_mul_ps(hi, _mm_set1_ps(65536.0f)), lo);
+
+    return _mm_mul_ps(f, _mm_set1_ps(k_Rnd_Scale));
+}
+//-----------------------------------------------------------------------------
+TARGET_SSE41 static __inline void Sin_Cos_SSE41(__m128 x, __m128 *s, __m128 *c)
+{
+    const __m128 sign_mask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+    __m128 sign_sin = _mm_and_ps(x, sign_mask);
+    x = _mm_andnot_ps(sign_mask, x);
+
+    __m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(k_FOPI)));
+    j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+    __m128 y = _mm_cvtepi32_ps(j);
+
+    const __m128i four = _mm_set1_epi32(4);
+    sign_sin = _mm_xor_ps(sign_sin, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, four), 29)));
+    __m128 sign_cos = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), four), 29));
+    __m128 poly = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128()));
+
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(k_DP1)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(k_DP2)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(k_DP3)));
+    __m128 z = _mm_mul_ps(x, x);
+
+    __m128 pc = _mm_set1_ps(k_Cos_P0);
+    pc = _mm_add_ps(_mm_mul_ps(pc, z), _mm_set1_ps(k_Cos_P1));
+    pc = _mm_add_ps(_mm_mul_ps(pc, z), _mm_set1_ps(k_Cos_P2));
+    pc = _mm_mul_ps(pc, z);
+    pc = _mm_mul_ps(pc, z);
+    pc = _mm_sub_ps(pc, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+    pc = _mm_add_ps(pc, _mm_set1_ps(1.0f));
+
+    __m128 ps = _mm_set1_ps(k_Sin_P0);
+    ps = _mm_add_ps(_mm_mul_ps(ps, z), _mm_set1_ps(k_Sin_P1));
+    ps = _mm_add_ps(_mm_mul_ps(ps, z), _mm_set1_ps(k_Sin_P2));
+    ps = _mm_mul_ps(ps, z);
+    ps = _mm_mul_ps(ps, x);
+    ps = _mm_add_ps(ps, x);
+
+    *s = _mm_xor_ps(_mm_blendv_ps(pc, ps, poly), sign_sin);
+    *c = _mm_xor_ps(_mm_blendv_ps(ps, pc, poly), sign_cos);
+}
+//-----------------------------------------------------------------------------
+TARGET_SSE41 static __inline void Evaluate_4_SSE41(const uint32_t *seeds, const __m128 *m, float *result)
+{
+    __m128i rnd = _mm_loadu_si128((const __m128i *)seeds);
+    __m128 x = Rnd_Float_SSE41(&rnd);
+    __m128 y = Rnd_Float_SSE41(&rnd);
+    __m128 z = Rnd_Float_SSE41(&rnd);
+    __m128 c = _mm_setzero_ps();
+
+    for (int k = 0; k < 8; ++k) {
+        __m128 tx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], x), _mm_mul_ps(m[4], y)), _mm_mul_ps(m[8], z)), m[12]);
+        __m128 ty = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[1], x), _mm_mul_ps(m[5], y)), _mm_mul_ps(m[9], z)), m[13]);
+        __m128 tz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[2], x), _mm_mul_ps(m[6], y)), _mm_mul_ps(m[10], z)), m[14]);
+
+        __m128 len2 = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)), _mm_mul_ps(tz, tz)), _mm_set1_ps(1.0f));
+        __m128 radius = _mm_sqrt_ps(len2);
+        __m128 theta = _mm_mul_ps(ty, _mm_div_ps(_mm_set1_ps(1.0f), tx));
+        __m128 s, co, s_theta, c_theta;
+        Sin_Cos_SSE41(_mm_sub_ps(theta, radius), &s, &co);
+        Sin_Cos_SSE41(theta, &s_theta, &c_theta);
+
+        x = _mm_mul_ps(radius, co);
+        y = _mm_mul_ps(radius, s);
+        z = tz;
+        c = _mm_add_ps(c, _mm_mul_ps(_mm_set1_ps(0.1f), s_theta));
+    }
+
+    _MM_TRANSPOSE4_PS(x, y, z, c);
+    _mm_storeu_ps(result + 0, x);
+    _mm_storeu_ps(result + 4, y);
+    _mm_storeu_ps(result + 8, z);
+    _mm_storeu_ps(result + 12, c);
+}
+//-----------------------------------------------------------------------------
+// 8 particles per iteration, two independent 4-wide chains to hide the sqrt/div latency.
+TARGET_SSE41 static void Evaluate_SSE41(const uint32_t *seeds, int count, const float *m, float *result)
+{
+    __m128 mv[16];
+    for (int i = 0; i < 16; ++i) mv[i] = _mm_set1_ps(m[i]);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        Evaluate_4_SSE41(seeds + i, mv, result + i * 4);
+        Evaluate_4_SSE41(seeds + i + 4, mv, result + i * 4 + 16);
+    }
+    Evaluate_Scalar(seeds + i, count - i, m, result + i * 4);
+}
+//=============================================================================
+TARGET_AVX2 static __inline __m256 Rnd_Float_AVX2(__m256i *rnd)
+{
+    *rnd = _mm256_add_epi32(_mm256_mullo_epi32(*rnd, _mm256_set1_epi32(196314165)), _mm256_set1_epi32(907633515));
+
+    __m256 hi = _mm256_cvtepi32_ps(_mm256_srli_epi32(*rnd, 16));
+    __m256 lo = _mm256_cvtepi32_ps(_mm256_and_si256(*rnd, _mm256_set1_epi32(0xffff)));
+    __m256 f = _mm256_add_ps(_mm256_mul_ps(hi, _mm256_set1_ps(65536.0f)), lo);
+
+    return _mm256_mul_ps(f, _mm256_set1_ps(k_Rnd_Scale));
+}
+//-----------------------------------------------------------------------------
+TARGET_AVX2 static __inline void Sin_Cos_AVX2(__m256 x, __m256 *s, __m256 *c)
+{
+    const __m256 sign_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+    __m256 sign_sin = _mm256_and_ps(x, sign_mask);
+    x = _mm256_andnot_ps(sign_mask, x);
+
+    __m256i j = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(k_FOPI)));
+    j = _mm256_and_si256(_mm256_add_epi32(j, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+    __m256 y = _mm256_cvtepi32_ps(j);
+
+    const __m256i four = _mm256_set1_epi32(4);
+    sign_sin = _mm256_xor_ps(sign_sin, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, four), 29)));
+    __m256 sign_cos = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_andnot_si256(_mm256_sub_epi32(j, _mm256_set1_epi32(2)), four), 29));
+    __m256 poly = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)), _mm256_setzero_si256()));
+
+    x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(k_DP1)));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(k_DP2)));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(k_DP3)));
+    __m256 z = _mm256_mul_ps(x, x);
+
+    __m256 pc = _mm256_set1_ps(k_Cos_P0);
+    pc = _mm256_add_ps(_mm256_mul_ps(pc, z), _mm256_set1_ps(k_Cos_P1));
+    pc = _mm256_add_ps(_mm256_mul_ps(pc, z), _mm256_set1_ps(k_Cos_P2));
+    pc = _mm256_mul_ps(pc, z);
+    pc = _mm256_mul_ps(pc, z);
+    pc = _mm256_sub_ps(pc, _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+    pc = _mm256_add_ps(pc, _mm256_set1_ps(1.0f));
+
+    __m256 ps = _mm256_set1_ps(k_Sin_P0);
+    ps = _mm256_add_ps(_mm256_mul_ps(ps, z), _mm256_set1_ps(k_Sin_P1));
+    ps = _mm256_add_ps(_mm256_mul_ps(ps, z), _mm256_set1_ps(k_Sin_P2));
+    ps = _mm256_mul_ps(ps, z);
+    ps = _mm256_mul_ps(ps, x);
+    ps = _mm256_add_ps(ps, x);
+
+    *s = _mm256_xor_ps(_mm256_blendv_ps(pc, ps, poly), sign_sin);
+    *c = _mm256_xor_ps(_mm256_blendv_ps(ps, pc, poly), sign_cos);
+}
+//-----------------------------------------------------------------------------
+TARGET_AVX2 static __inline void Evaluate_8_AVX2(const uint32_t *seeds, const __m256 *m, float *result)
+{
+    __m256i rnd = _mm256_loadu_si256((const __m256i *)seeds);
+    __m256 x = Rnd_Float_AVX2(&rnd);
+    __m256 y = Rnd_Float_AVX2(&rnd);
+    __m256 z = Rnd_Float_AVX2(&rnd);
+    __m256 c = _mm256_setzero_ps();
+
+    for (int k = 0; k < 8; ++k) {
+        __m256 tx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[0], x), _mm256_mul_ps(m[4], y)), _mm256_mul_ps(m[8], z)), m[12]);
+        __m256 ty = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[1], x), _mm256_mul_ps(m[5], y)), _mm256_mul_ps(m[9], z)), m[13]);
+        __m256 tz = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[2], x), _mm256_mul_ps(m[6], y)), _mm256_mul_ps(m[10], z)), m[14]);
+
+        __m256 len2 = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, tx), _mm256_mul_ps(ty, ty)), _mm256_mul_ps(tz, tz)), _mm256_set1_ps(1.0f));
+        __m256 radius = _mm256_sqrt_ps(len2);
+        __m256 theta = _mm256_mul_ps(ty, _mm256_div_ps(_mm256_set1_ps(1.0f), tx));
+        __m256 s, co, s_theta, c_theta;
+        Sin_Cos_AVX2(_mm256_sub_ps(theta, radius), &s, &co);
+        Sin_Cos_AVX2(theta, &s_theta, &c_theta);
+
+        x = _mm256_mul_ps(radius, co);
+        y = _mm256_mul_ps(radius, s);
+        z = tz;
+        c = _mm256_add_ps(c, _mm256_mul_ps(_mm256_set1_ps(0.1f), s_theta));
+    }
+
+    // SoA to float4 per particle, 4x4 transposes within each 128-bit half
+    __m256 t0 = _mm256_unpacklo_ps(x, y);
+    __m256 t1 = _mm256_unpackhi_ps(x, y);
+    __m256 t2 = _mm256_unpacklo_ps(z, c);
+    __m256 t3 = _mm256_unpackhi_ps(z, c);
+    __m256 p04 = _mm256_shuffle_ps(t0, t2, 0x44);
+    __m256 p15 = _mm256_shuffle_ps(t0, t2, 0xee);
+    __m256 p26 = _mm256_shuffle_ps(t1, t3, 0x44);
+    __m256 p37 = _mm256_shuffle_ps(t1, t3, 0xee);
+    _mm256_storeu_ps(result + 0, _mm256_permute2f128_ps(p04, p15, 0x20));
+    _mm256_storeu_ps(result + 8, _mm256_permute2f128_ps(p26, p37, 0x20));
+    _mm256_storeu_ps(result + 16, _mm256_permute2f128_ps(p04, p15, 0x31));
+    _mm256_storeu_ps(result + 24, _mm256_permute2f128_ps(p26, p37, 0x31));
+}
+//-----------------------------------------------------------------------------
+// 16 particles per iteration, two independent 8-wide chains.
+TARGET_AVX2 static void Evaluate_AVX2(const uint32_t *seeds, int count, const float *m, float *result)
+{
+    __m256 mv[16];
+    for (int i = 0; i < 16; ++i) mv[i] = _mm256_set1_ps(m[i]);
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        Evaluate_8_AVX2(seeds + i, mv, result + i * 4);
+        Evaluate_8_AVX2(seeds + i + 8, mv, result + i * 4 + 32);
+    }
+    Evaluate_Scalar(seeds + i, count - i, m, result + i * 4);
+}
+//-----------------------------------------------------------------------------
+static void Cpu_Features(int *sse41, int *avx2)
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+
+    __cpuid(info, 1);
+    *sse41 = (info[2] >> 19) & 1;
+    int os_avx = ((info[2] >> 27) & 1) && ((info[2] >> 28) & 1) && (_xgetbv(0) & 6) == 6;
+
+    *avx2 = 0;
+    if (max_leaf >= 7 && os_avx) {
+        __cpuidex(info, 7, 0);
+        *avx2 = (info[1] >> 5) & 1;
+    }
+#else
+    __builtin_cpu_init();
+    *sse41 = __builtin_cpu_supports("sse4.1");
+    *avx2 = __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+//=============================================================================
+static void Select_Kernel(void)
+{
+    if (s_kernel) return;
+
+    s_kernel = Evaluate_Scalar;
+    s_kernel_name = "scalar";
+
+#if defined(PARTICLE_CPU_X86)
+    int sse41, avx2;
+    Cpu_Features(&sse41, &avx2);
+    if (avx2) {
+        s_kernel = Evaluate_AVX2;
+        s_kernel_name = "AVX2";
+    } else if (sse41) {
+        s_kernel = Evaluate_SSE41;
+        s_kernel_name = "SSE4.1";
+    }
+#endif
+}
+//-----------------------------------------------------------------------------
+static void Particle_CPU_Job(void *data, int job_index, int worker_index)
+{
+    (void)worker_index;
+    PARTICLE_CPU_JOB *job = data;
+    int first = (int)((int64_t)job->count * job_index / job->job_count);
+    int last = (int)((int64_t)job->count * (job_index + 1) / job->job_count);
+
+    s_kernel(job->seeds + first, last - first, job->m, job->result + (size_t)first * 4);
+}
+//-----------------------------------------------------------------------------
+void Particle_CPU_Evaluate(const uint32_t *seeds, int count, uint32_t seed, float palette_factor, float *result)
+{
+    float m[16];
+    Particle_CPU_Transform(seed, palette_factor, m);
+    Select_Kernel();
+
+    PARTICLE_CPU_JOB job = { seeds, count, Jobs_Worker_Count(), m, result };
+
+    if (job.job_count > 1 && Jobs_Submit(Particle_CPU_Job, &job, job.job_count)) {
+        Jobs_Wait();
+    } else {
+        s_kernel(seeds, count, m, result);
+    }
+}
+//-----------------------------------------------------------------------------
+const char *Particle_CPU_Kernel_Name(void)
+{
+    Select_Kernel();
+    return s_kernel_name;
+}
+//=============================================================================
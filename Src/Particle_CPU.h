@@ -0,0 +1,38 @@
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+
+// CPU reference of the particle math in VS_Particle_Draw.vert and CS_Particle_Evaluate.comp.
+// Every particle yields one float4: position in xyz, palette coordinate in w, the layout of the
+// GPU particle cache. The scalar, SSE4.1 and AVX2 kernels run the same operations in the same
+// order, including a shared sine/cosine polynomial, so they agree with each other. Against the
+// GPU the result is close but not exact, the swirl amplifies differences in sin/cos precision.
+// -verify runs it after the frame loop against a readback of the particle cache.
+
+// The blended TRS transform of the shader, column major. seed is g_constant.data[0],
+// palette_factor the smoothed value of g_constant.palette_factor.
+void Particle_CPU_Transform(uint32_t seed, float palette_factor, float transform[16]);
+
+// Evaluates count particles from the seeds generated by Create_Particles into result
+// (4 * count floats). Split over the job workers when Jobs_Init was called, so it must not
+// overlap another Jobs_Submit.
+void Particle_CPU_Evaluate(const uint32_t *seeds, int count, uint32_t seed, float palette_factor, float *result);
+
+// "AVX2", "SSE4.1" or "scalar", the kernel Particle_CPU_Evaluate picked for this CPU.
+const char *Particle_CPU_Kernel_Name(void);
@@ -14,18 +14,77 @@
 // limitations under the License.
 /////////////////////////////////////////////////////////////////////////////////////////////
 
+// The k_Def_ values are defaults of the command line flags, see Parse_Command_Line in Stardust.c
+
 // Number of cmdBuffer & other object siblings for inter-frame double buffering
 #define k_Resource_Buffering 3
 
 // The total number of points
 #define k_Def_Point_Count 2000000
 
+// Number of frames the CPU may record ahead of the GPU, at most k_Resource_Buffering.
+// Independent of the swapchain image count.
+#define k_Def_Frames_In_Flight 2
+
 // Number of points per draw call
 #define k_Def_Batch_Size 10
 
+// Number of particle command buffers per worker thread, idle workers steal the rest
+#define k_Particle_Chunks_Per_Worker 4
+
+// Record particle chunks as secondary command buffers executed inside one render pass
+#define k_Def_Secondary_Cmdbufs 0
+
+// Record particle command buffers once per resource slot and resubmit them until the config changes
+#define k_Def_Prerecorded 0
+
+// Evaluate particle positions in a compute pass only when the transform changes, draw from the cache
+#define k_Def_Cached_Positions 0
+
+// -verify compares the GPU particle cache with the CPU reference after the run. The attractor is
+// chaotic, so float differences in sin/cos grow along the swirl: a particle matches when every
+// component is within k_Verify_Epsilon (relative, absolute below 1), and the run passes when at
+// least k_Verify_Min_Match of the particles match.
+#define k_Verify_Epsilon 1e-2f
+#define k_Verify_Min_Match 0.5f
+
+// Pass viewproj, seed and palette factor of the particle and skybox shaders as push constants
+// instead of reading them from the constant storage buffer. Fixed at startup. The values are
+// produced before the particle recording starts, so the camera trails the input by one frame.
+#define k_Def_Push_Constants 0
+
+// Bytes of the per-frame upload ring owned by each resource slot (constants, graph and font vertices)
+#define k_Upload_Ring_Slot_Size (1024 * 1024)
+
+// Pipeline cache blob, loaded at startup and written back at shutdown
+#define k_Pipeline_Cache_File "Stardust_Pipeline_Cache.bin"
+
+// Offscreen rendering without a window, surface or swapchain, paced by the frame fences.
+// Runs a fixed number of frames and logs the frame time, works on software ICDs such as lavapipe.
+#define k_Def_Headless 0
+#define k_Headless_Width 1280
+#define k_Headless_Height 720
+#define k_Headless_Frame_Count 500
+
+// Swapchain present mode as a VkPresentModeKHR value, -1 takes the first IMMEDIATE or FIFO
+// mode reported by the surface
+#define k_Def_Present_Mode -1
+
+// Benchmark run (-benchmark or -output): frames discarded before measuring, and the default
+// number of measured frames when -frames is not given
+#define k_Def_Benchmark_Warmup 100
+#define k_Def_Benchmark_Frames 1000
+
+// Chrome trace-event markers kept per thread, the oldest are overwritten. Written to the
+// -trace file on exit, or by F6 to that file or k_Trace_File.
+#define k_Trace_Events_Per_Thread 16384
+#define k_Trace_File "Stardust_Trace.json"
+
 // Metrics graph settings
 #define k_Graph_Samples 60
 #define k_Graph_Width 200
 #define k_Graph_Height 134
 
-#define MAX_CPU_CORES 16
+// GPU frame time at the top of the GPU graph, in milliseconds
+#define k_Gpu_Graph_Ms 33.3f
+
@@ -19,41 +19,229 @@
 #include "Misc.h"
 #include "Metrics.h"
 #include "Graph.h"
+#include "Topology.h"
+#include "Texture_File.h"
 
 #include "SDL.h"
+#ifdef _WIN32
 #include "SDL_syswm.h"
+#endif
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <assert.h>
 
+static const char *s_usage =
+    "usage: Stardust [-points N] [-batch N] [-workers N] [-frames-in-flight N]\n"
+    "                [-submit primary|secondary|prerecorded|prerecorded-secondary]\n"
+    "                [-draw direct|indirect] [-cached] [-push-constants] [-verify]\n"
+    "                [-frames N] [-resolution WxH] [-windowed|-fullscreen|-headless]\n"
+    "                [-present immediate|mailbox|fifo|fifo-relaxed] [-verbose]\n"
+    "                [-benchmark] [-warmup N] [-output report.json|report.csv] [-trace trace.json]\n"
+    "       Stardust -convert-texture [-bc1] [-mips] out.sdtx layer0.png [layer1.png ...]\n";
+
+static const char *s_submit_mode_name[4] = { "primary", "secondary", "prerecorded", "prerecorded-secondary" };
+static const char *s_draw_mode_name[DRAW_MODE_COUNT] = { "direct", "indirect" };
+// indexed by VkPresentModeKHR
+static const char *s_present_mode_name[4] = { "immediate", "mailbox", "fifo", "fifo-relaxed" };
+
+const char *Submit_Mode_Name(const struct glob_state_t *state)
+{
+    return s_submit_mode_name[(state->prerecorded ? 2 : 0) + (state->secondary_cmdbufs ? 1 : 0)];
+}
+
+const char *Draw_Mode_Name(int draw_mode)
+{
+    return draw_mode >= 0 && draw_mode < DRAW_MODE_COUNT ? s_draw_mode_name[draw_mode] : "unknown";
+}
+
+const char *Present_Mode_Name(int present_mode)
+{
+    if (present_mode < 0) return "default";
+    return (size_t)present_mode < SDL_arraysize(s_present_mode_name) ? s_present_mode_name[present_mode] : "unknown";
+}
+
+static int Find_Name(const char *value, const char **names, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        if (!strcmp(value, names[i])) return i;
+    }
+    return -1;
+}
+
+static int Parse_Int(const char *flag, const char *value, int min, int max, int *result)
+{
+    char *end;
+    // long is 32-bit on Windows, an out of range value clamps to LONG_MIN/LONG_MAX and sets ERANGE
+    errno = 0;
+    long v = strtol(value, &end, 10);
+
+    if (end == value || *end || errno == ERANGE || v < min || v > max) {
+        Log("%s expects an integer in [%d, %d], got '%s'\n", flag, min, max, value);
+        return 0;
+    }
+    *result = (int)v;
+    return 1;
+}
+
+// Returns STARDUST_CONTINUE, STARDUST_EXIT for -help or STARDUST_ERROR for a bad flag.
+// Limits of the device are checked later in VK_Init.
+static int Parse_Command_Line(struct glob_state_t *state, int argc, char **argv)
+{
+    int width = 0, height = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const char *flag = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        int ok = 1, index;
+
+        if (!strcmp(flag, "-help") || !strcmp(flag, "-h") || !strcmp(flag, "-?")) {
+            Log("%s", s_usage);
+            return STARDUST_EXIT;
+        }
+        else if (!strcmp(flag, "-cached")) state->cached_positions = 1;
+        else if (!strcmp(flag, "-push-constants")) state->push_constants = 1;
+        else if (!strcmp(flag, "-verify")) state->verify = 1;
+        else if (!strcmp(flag, "-windowed")) state->windowed = 1;
+        else if (!strcmp(flag, "-fullscreen")) state->windowed = 0;
+        else if (!strcmp(flag, "-headless")) state->headless = 1;
+        else if (!strcmp(flag, "-verbose")) state->verbose = 1;
+        else if (!strcmp(flag, "-benchmark")) state->benchmark = 1;
+        else if (!value) {
+            Log("Unknown flag or missing value: %s\n%s", flag, s_usage);
+            return STARDUST_ERROR;
+        }
+        else {
+            ++i;
+            if (!strcmp(flag, "-points")) ok = Parse_Int(flag, value, 1, INT32_MAX, &state->point_count);
+            else if (!strcmp(flag, "-batch")) ok = Parse_Int(flag, value, 1, INT32_MAX, &state->batch_size);
+            else if (!strcmp(flag, "-workers")) ok = Parse_Int(flag, value, 1, Topology_Logical_Count(), &state->cpu_core_count);
+            else if (!strcmp(flag, "-frames-in-flight")) ok = Parse_Int(flag, value, 1, k_Resource_Buffering, &state->frames_in_flight);
+            else if (!strcmp(flag, "-frames")) ok = Parse_Int(flag, value, 0, INT32_MAX, &state->frame_count);
+            else if (!strcmp(flag, "-warmup")) ok = Parse_Int(flag, value, 0, INT32_MAX, &state->warmup_frames);
+            else if (!strcmp(flag, "-output")) state->output_file = value;
+            else if (!strcmp(flag, "-trace")) state->trace_file = value;
+            else if (!strcmp(flag, "-resolution")) {
+                char tail;
+                ok = sscanf(value, "%dx%d%c", &width, &height, &tail) == 2 && width > 0 && height > 0;
+                if (!ok) Log("-resolution expects WxH, got '%s'\n", value);
+            }
+            else if (!strcmp(flag, "-submit")) {
+                ok = (index = Find_Name(value, s_submit_mode_name, SDL_arraysize(s_submit_mode_name))) >= 0;
+                if (ok) {
+                    state->secondary_cmdbufs = index & 1;
+                    state->prerecorded = index >> 1;
+                }
+                else Log("Unknown submission mode '%s'\n", value);
+            }
+            else if (!strcmp(flag, "-draw")) {
+                ok = (index = Find_Name(value, s_draw_mode_name, DRAW_MODE_COUNT)) >= 0;
+                if (ok) state->draw_mode = index;
+                else Log("Unknown draw mode '%s'\n", value);
+            }
+            else if (!strcmp(flag, "-present")) {
+                ok = (index = Find_Name(value, s_present_mode_name, SDL_arraysize(s_present_mode_name))) >= 0;
+                if (ok) state->present_mode = index;
+                else Log("Unknown present mode '%s'\n", value);
+            }
+            else {
+                Log("Unknown flag: %s\n%s", flag, s_usage);
+                return STARDUST_ERROR;
+            }
+        }
+        if (!ok) return STARDUST_ERROR;
+    }
+
+    if (state->batch_size > state->point_count) {
+        Log("-batch %d is larger than -points %d\n", state->batch_size, state->point_count);
+        return STARDUST_ERROR;
+    }
+    state->width = width;
+    state->height = height;
+
+    // the CPU reference is compared with the position cache, so the cache has to be in use
+    if (state->verify) state->cached_positions = 1;
+    // a report needs a fixed number of measured frames
+    if (state->output_file) state->benchmark = 1;
+    if (state->benchmark && !state->frame_count) state->frame_count = k_Def_Benchmark_Frames;
+    if (!state->benchmark) state->warmup_frames = 0;
+
+    return STARDUST_CONTINUE;
+}
+
+void Log_Config(const struct glob_state_t *state)
+{
+    Enable_Logging(1);
+    Log("Config: -points %d -batch %d -workers %d -frames-in-flight %d -submit %s -draw %s%s%s%s",
+        state->point_count, state->batch_size, state->cpu_core_count, state->frames_in_flight,
+        Submit_Mode_Name(state), Draw_Mode_Name(state->draw_mode),
+        state->cached_positions ? " -cached" : "", state->push_constants ? " -push-constants" : "",
+        state->verify ? " -verify" : "");
+    Log("Config: -frames %d -resolution %dx%d %s -present %s",
+        state->frame_count, state->width, state->height,
+        state->headless ? "-headless" : state->windowed ? "-windowed" : "-fullscreen",
+        Present_Mode_Name(state->present_mode));
+    if (state->trace_file) Log("Config: -trace %s", state->trace_file);
+    if (state->benchmark) {
+        Log("Config: -benchmark -warmup %d%s%s", state->warmup_frames, state->output_file ? " -output " : "",
+            state->output_file ? state->output_file : "");
+    }
+    Enable_Logging(state->verbose);
+}
+
 int Global_Init(struct glob_state_t *state, int argc, char **argv)
 {
     memset(state, 0, sizeof(*state));
-#if defined(_WIN32)
-    SYSTEM_INFO si;
-    GetSystemInfo(&si);
-    state->cpu_core_count = si.dwNumberOfProcessors;
-#else
-    state->cpu_core_count = 4;
-#endif
+    if (!Topology_Init()) {
+        Log("Topology initialization failed");
+        return 1;
+    }
+    state->cpu_core_count = Topology_Logical_Count();
+
     state->transform_time = 0.2;
     state->transform_animate = 1;
     state->windowed = 1;
     state->seed = 23232323;
     state->batch_size = k_Def_Batch_Size;
     state->point_count = k_Def_Point_Count;
+    state->secondary_cmdbufs = k_Def_Secondary_Cmdbufs;
+    state->prerecorded = k_Def_Prerecorded;
+    state->frames_in_flight = k_Def_Frames_In_Flight;
+    state->draw_mode = DRAW_MODE_DIRECT;
+    state->cached_positions = k_Def_Cached_Positions;
+    state->push_constants = k_Def_Push_Constants;
+    state->headless = k_Def_Headless;
+    state->present_mode = k_Def_Present_Mode;
+    state->warmup_frames = k_Def_Benchmark_Warmup;
+
+    // usage errors and the effective configuration are always logged, the rest only with -verbose
+    Enable_Logging(1);
+    int exit_code = Parse_Command_Line(state, argc, argv);
+    if (exit_code != STARDUST_CONTINUE) return exit_code;
+    Enable_Logging(state->verbose);
+
+    state->graph_data = calloc(state->cpu_core_count, sizeof(*state->graph_data));
+    if (!state->graph_data) return 1;
+
     for (int i = 0; i < 6 * 9; ++i) {
         RND_GEN(state->seed);
     }
     for (int i = 0; i < state->cpu_core_count; i++) {
         state->graph_data[i].empty_flag = 1;
     }
-    Enable_Logging(state->verbose);
 
     if (!Metrics_Init()) {
         Log("Metrics initialization failed");
         return 1;
     }
 
+    if (state->headless) {
+        if (!state->width) state->width = k_Headless_Width;
+        if (!state->height) state->height = k_Headless_Height;
+        if (!state->frame_count) state->frame_count = k_Headless_Frame_Count;
+        return SDL_Init(SDL_INIT_TIMER) < 0 ? STARDUST_ERROR : STARDUST_CONTINUE;
+    }
+
 #if defined(_WIN32)
     // This informs the WM, that we can handle high DPI ourselves and disables scaling. 
     // This is required, so SDL_GetDisplayBounds returns sane values on highDPI below.
@@ -68,10 +256,16 @@ int Global_Init(struct glob_state_t *state, int argc, char **argv)
 
     int xoffset, yoffset;
     if (!state->windowed) {
+        if (state->width && (state->width != dpyBounds.w || state->height != dpyBounds.h)) {
+            Log("-resolution is ignored in fullscreen, using the display size\n");
+        }
         state->width = dpyBounds.w;
         state->height = dpyBounds.h;
         xoffset = dpyBounds.x;
         yoffset = dpyBounds.y;
+    } else if (state->width) {
+        xoffset = SDL_WINDOWPOS_CENTERED;
+        yoffset = SDL_WINDOWPOS_CENTERED;
     } else {
         state->width  = (int)(dpyBounds.w * 0.9);
         state->height = (int)(dpyBounds.h * 0.9);
@@ -89,10 +283,15 @@ int Global_Init(struct glob_state_t *state, int argc, char **argv)
         return STARDUST_ERROR;
     }
 
+    // the window handle only feeds the Win32 surface, other platforms have no window surface
+#ifdef _WIN32
     SDL_SysWMinfo info;
     SDL_VERSION(&info.version);
     SDL_GetWindowWMInfo(state->window, &info);
     state->hwnd = info.info.win.window;
+#else
+    Log("No window surface on this platform, use -headless\n");
+#endif
 
     if (!state->hwnd) {
         Log("SDL_GetWindowWMInfo failed: zero HWND");
@@ -107,6 +306,9 @@ int Global_Deinit(struct glob_state_t *state)
         SDL_DestroyWindow(state->window);
     }
     SDL_Quit();
+    free(state->graph_data);
+    state->graph_data = NULL;
+    Topology_Shutdown();
     return STARDUST_CONTINUE;
 }
 
@@ -126,27 +328,75 @@ int Handle_Events(struct glob_state_t *state)
             else if (evt.key.keysym.sym == SDLK_SPACE) {
                 state->transform_animate = !state->transform_animate;
             }
+            else if (evt.key.keysym.sym == SDLK_F1) {
+                state->secondary_cmdbufs = !state->secondary_cmdbufs;
+                Log("Particle command buffers: %s\n", state->secondary_cmdbufs ? "secondary" : "primary");
+            }
+            else if (evt.key.keysym.sym == SDLK_F2) {
+                state->prerecorded = !state->prerecorded;
+                Log("Prerecorded particle command buffers: %s\n", state->prerecorded ? "on" : "off");
+            }
+            else if (evt.key.keysym.sym == SDLK_F3) {
+                state->frames_in_flight = state->frames_in_flight % k_Resource_Buffering + 1;
+                Log("Frames in flight: %d\n", state->frames_in_flight);
+            }
+            else if (evt.key.keysym.sym == SDLK_F4) {
+                state->draw_mode = (state->draw_mode + 1) % DRAW_MODE_COUNT;
+                Log("Particle draw mode: %d\n", state->draw_mode);
+            }
+            else if (evt.key.keysym.sym == SDLK_F5) {
+                state->cached_positions = !state->cached_positions;
+                Log("Cached particle positions: %s\n", state->cached_positions ? "on" : "off");
+            }
+            else if (evt.key.keysym.sym == SDLK_F6) {
+                // written by VK_Run once the particle jobs of the frame are done
+                state->trace_requested = 1;
+            }
         }
     }
     return exit_code;
 }
 
+// Stardust -convert-texture [-bc1] [-mips] out.sdtx layer0.png [layer1.png ...]
+static int Convert_Texture(int argc, char **argv)
+{
+    VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+    int with_mips = 0;
+
+    for (; argc > 0 && argv[0][0] == '-'; --argc, ++argv) {
+        if (!strcmp(argv[0], "-bc1")) format = VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+        else if (!strcmp(argv[0], "-mips")) with_mips = 1;
+        else break;
+    }
+    if (argc < 2) {
+        Log("usage: Stardust -convert-texture [-bc1] [-mips] out.sdtx layer0.png [layer1.png ...]\n");
+        return 0;
+    }
+
+    return Texture_File_Convert(argv[0], (const char **)&argv[1], argc - 1, format, with_mips);
+}
+
 int SDL_main(int argc, char *argv[])
 {
     int exit_code = STARDUST_CONTINUE;
     int not_supported_count = 0;
 
-#if defined(_WIN32)
-    /* core 0 as default */ {
-        DWORD_PTR procAffinityMask = 1;
-        BOOL res = 0 != SetThreadAffinityMask(GetCurrentThread(), procAffinityMask);
+    // offline texture conversion, see Data/Texture/convert.bat
+    if (argc > 1 && !strcmp(argv[1], "-convert-texture")) {
+        return Convert_Texture(argc - 2, argv + 2) ? 0 : 1;
     }
-#endif
+
     struct glob_state_t global_state;
-    if (Global_Init(&global_state, argc, argv) != STARDUST_CONTINUE) {
+    exit_code = Global_Init(&global_state, argc, argv);
+    if (exit_code == STARDUST_EXIT) {
+        return 0;
+    }
+    if (exit_code != STARDUST_CONTINUE) {
         Log("Application initialization failed");
         return 1;
     }
+    // main thread is job worker 0
+    Topology_Pin_Thread(0);
 
     if (VK_Init(&global_state) == STARDUST_CONTINUE) {
         VK_Run(&global_state);
@@ -157,18 +407,15 @@ int SDL_main(int argc, char *argv[])
     return 1;
 }
 
-#ifdef _WIN32
-
 #if defined(NO_CONSOLE) && defined(_WIN32)
 int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPSTR lpCmdLine, _In_ int nShowCmd)
 {
     return SDL_main(__argc, __argv);
 }
-#else
+#elif !defined(__ANDROID__)
+// also the entry point of the Linux build, which only supports -headless
 int main(int argc, char **argv)
 {
     return SDL_main(argc, argv);
 }
 #endif
-
-#endif
@@ -27,6 +27,13 @@ enum exit_code_t
     STARDUST_CONTINUE
 };
 
+enum draw_mode_t
+{
+    DRAW_MODE_DIRECT = 0,
+    DRAW_MODE_INDIRECT,
+    DRAW_MODE_COUNT
+};
+
 struct graph_data_t
 {
     int sampleidx;
@@ -49,10 +56,25 @@ struct glob_state_t
     float palette_factor;
     int palette_image_idx;
     unsigned int seed;
-    struct graph_data_t graph_data[MAX_CPU_CORES];
+    struct graph_data_t *graph_data;
 
     int batch_size;
     int point_count;
+    int secondary_cmdbufs;
+    int prerecorded;
+    int frames_in_flight;
+    int draw_mode;
+    int cached_positions;
+    int push_constants;
+    int verify;
+    int headless;
+    int frame_count;
+    int present_mode;
+    int benchmark;
+    int warmup_frames;
+    const char *output_file;
+    const char *trace_file;
+    int trace_requested;
     int windowed;
     int verbose;
     int cpu_core_count;
@@ -62,3 +84,8 @@ int VK_Init(struct glob_state_t *state);
 int VK_Shutdown(struct glob_state_t *state);
 int VK_Run(struct glob_state_t *state);
 int Handle_Events(struct glob_state_t *state);
+
+const char *Submit_Mode_Name(const struct glob_state_t *state);
+const char *Draw_Mode_Name(int draw_mode);
+const char *Present_Mode_Name(int present_mode);
+void Log_Config(const struct glob_state_t *state);
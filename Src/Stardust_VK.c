@@ -16,13 +16,20 @@
 
 #include "Settings.h"
 #include <string.h>
+#include <stddef.h>
 #include "SDL.h"
 #include "VKU.h"
 #include "Misc.h"
 #include "Graph.h"
 #include "Stardust.h"
+#include "Particle_CPU.h"
 #include "vectormath_aos.h"
 #include "Metrics.h"
+#include "Jobs.h"
+#include "Texture_File.h"
+#include "Topology.h"
+#include "Benchmark.h"
+#include "Trace.h"
 #include "stretchy_buffer.h"
 #include "stb_image.h"
 #include "stb_font_consolas_24_usascii.inl"
@@ -44,8 +51,14 @@
 #endif
 //=============================================================================
 #define k_Window_Buffering k_Resource_Buffering
-#define DRAW_PER_THREAD ((s_glob_state->point_count / s_glob_state->batch_size) / s_glob_state->cpu_core_count)
+#define DRAW_COUNT (s_glob_state->point_count / s_glob_state->batch_size)
 #define MT_UPDATE
+#define k_Particle_Seed 23232323u
+#define k_Constant_Size (4 * sizeof(VmathMatrix4) + sizeof(float))
+#define k_Palette_Count 5
+#define k_Texture_Upload_Count 12
+#define k_Texture_Source_Count 7
+#define k_Font_Max_Letters 512
 //=============================================================================
 typedef struct ViewportState
 {
@@ -74,14 +87,122 @@ typedef struct DepthStencilState
     float                              maxDepthBounds;
 } DepthStencilState;
 
-typedef struct THREAD_DATA
+typedef struct PARTICLE_CHUNK
 {
-    int                                 tid;
+    int                                 first_draw;
+    int                                 draw_count;
+    int                                 result;
     VkCommandBuffer                     cmdbuf[k_Resource_Buffering];
+    VkCommandBuffer                     cmdbuf_secondary[k_Resource_Buffering];
     VkCommandPool                       cmdpool;
-    SDL_sem                             *sem;
-    SDL_Thread                          *thread;
-} THREAD_DATA;
+} PARTICLE_CHUNK;
+
+typedef struct PARTICLE_RECORDING
+{
+    int                                 valid;
+    int                                 secondary;
+    int                                 point_count;
+    int                                 batch_size;
+    int                                 chunk_count;
+    VkFramebuffer                       framebuffer;
+    int                                 palette_image_idx;
+    int                                 draw_mode;
+    int                                 cached;
+    uint32_t                            constant_offset;
+} PARTICLE_RECORDING;
+
+// Per-frame parameters of VS_Particle_Draw_Push, FS_Particle_Draw_Push and VS_Skybox_Push
+typedef struct PUSH_CONSTANT
+{
+    VmathMatrix4                        viewproj;
+    uint32_t                            seed;
+    float                               palette_factor;
+} PUSH_CONSTANT;
+// The shaders declare the block with offsets 0, 64 and 68, 72 bytes in total
+SDL_COMPILE_TIME_ASSERT(push_constant_size, sizeof(PUSH_CONSTANT) == 72);
+SDL_COMPILE_TIME_ASSERT(push_constant_seed, offsetof(PUSH_CONSTANT, seed) == 64);
+SDL_COMPILE_TIME_ASSERT(push_constant_palette_factor, offsetof(PUSH_CONSTANT, palette_factor) == 68);
+
+// Nodes of the Demo_Init task graph, see Run_Init_Tasks
+enum
+{
+    INIT_COMMON_DSET,
+    INIT_DYNAMIC_STATES,
+    INIT_FLOAT_RENDERPASS,
+    INIT_DISPLAY_RENDERPASS,
+    INIT_COPY_RENDERPASS,
+    INIT_PARTICLE_PIPELINE,
+    INIT_PARTICLE_CACHED_PIPELINE,
+    INIT_PARTICLE_EVALUATE_PIPELINE,
+    INIT_DISPLAY_PIPELINE,
+    INIT_GRAPH_TRI_STRIP_PIPELINE,
+    INIT_GRAPH_LINE_STRIP_PIPELINE,
+    INIT_GRAPH_LINE_LIST_PIPELINE,
+    INIT_COPY_PIPELINE,
+    INIT_FONT_PIPELINE,
+    INIT_SKYBOX_PIPELINE,
+    INIT_SKYBOX_GENERATE_PIPELINE,
+    INIT_TASK_COUNT
+};
+#define INIT_DEP(task) (1u << (task))
+
+// CPU phases of a frame in the benchmark report, see Benchmark_End_Phase
+enum
+{
+    PHASE_FENCE_WAIT,
+    PHASE_UPDATE,
+    PHASE_RECORD,
+    PHASE_ACQUIRE,
+    PHASE_PARTICLE_WAIT,
+    PHASE_SUBMIT,
+    PHASE_PRESENT,
+    PHASE_COUNT
+};
+
+// Passes timed with GPU timestamps, GPU_PASS_FRAME spans all of them
+enum
+{
+    GPU_PASS_FRAME,
+    GPU_PASS_CLEAR,
+    GPU_PASS_SKYBOX,
+    GPU_PASS_COMPUTE,
+    GPU_PASS_PARTICLES,
+    GPU_PASS_DISPLAY,
+    GPU_PASS_HUD,
+    GPU_PASS_COUNT
+};
+
+// Pass i owns timestamps 2 * i (begin) and 2 * i + 1 (end) of a resource slot, see Cmd_Begin_Gpu_Pass
+enum
+{
+    TIMESTAMP_COUNT = 2 * GPU_PASS_COUNT
+};
+
+typedef struct INIT_TASK
+{
+    const char                          *name;
+    int                                 (*func)(void);
+    uint32_t                            depends;
+} INIT_TASK;
+
+// A texture comes from its .sdtx container when that exists, matches and the device samples its
+// format, from the PNGs otherwise. 0 is the skybox cube, 1..6 the palettes.
+typedef struct TEXTURE_DESC
+{
+    const char                          *container;
+    const char                          *png[6];
+    uint32_t                            layer_count;
+    uint32_t                            width;
+    uint32_t                            height;
+} TEXTURE_DESC;
+
+typedef struct TEXTURE_SOURCE
+{
+    const TEXTURE_DESC                  *desc;
+    TEXTURE_FILE                        file;
+    VkFormat                            format;
+    uint32_t                            mip_count;
+} TEXTURE_SOURCE;
 
 typedef struct GRAPH_SHADER_IN
 {
@@ -91,8 +212,7 @@ typedef struct GRAPH_SHADER_IN
 
 typedef struct GRAPH
 {
-    VkDeviceMemory                     buffer_mem[k_Resource_Buffering];
-    VkBuffer                           buffer[k_Resource_Buffering];
+    VkDeviceSize                       offset;
     int                                x, y, w, h;
     float                              color[4];
     ViewportState                      viewport;
@@ -100,21 +220,35 @@ typedef struct GRAPH
 } GRAPH;
 //=============================================================================
 static int                            Demo_Init(void);
+static int                            Run_Init_Tasks(void);
 static int                            Demo_Shutdown(void);
 static int                            Demo_Update(void);
+static int                            Begin_Frame(int res_idx);
+static int                            Finish_Particle_Recording(void);
 static void                           Update_Camera(void);
+static void                           Update_Palette(void);
 static int                            Update_Constant_Memory(void);
 static int                            Create_Depth_Stencil(void);
 static int                            Create_Common_Dset(void);
-static void                           Update_Common_Dset(void);
-static int                            Create_Constant_Memory(void);
+static void                           Write_Common_Dset(VkDescriptorSet dset, int palette_idx);
+static int                            Create_Upload_Ring(void);
+static VkResult                       Create_Graphics_Pipeline(const VkGraphicsPipelineCreateInfo *info, VkPipeline *pipe);
+static VkResult                       Create_Compute_Pipeline(const VkComputePipelineCreateInfo *info, VkPipeline *pipe);
+static void                           Reset_Upload_Ring(void);
+static void                           *Upload_Alloc(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *offset);
+static int                            Create_Staging_Buffer(VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory);
+static int                            Copy_Buffer_And_Wait(VkBuffer src, VkBuffer dst, VkDeviceSize size, VkAccessFlags src_access, VkPipelineStageFlags src_stage,
+                                                           VkAccessFlags dst_access, VkPipelineStageFlags dst_stage);
 static int                            Create_Particles(void);
+static int                            Create_Particle_Indirect_Buffer(void);
+static int                            Create_Particle_Cache_Buffer(void);
+static int                            Create_Particle_Compute_Pipeline(const char *filename, VkPipeline *pipe);
 static int                            Create_Skybox_Geometry(void);
 static int                            Create_Float_Renderpass(void);
 static int                            Init_Dynamic_States(void);
 static int                            Create_Skybox_Pipeline(void);
 static int                            Create_Skybox_Generate_Pipeline(void);
-static int                            Create_Particle_Pipeline(void);
+static int                            Create_Particle_Pipeline(const char *vs_filename, int seed_input, VkPipeline *pipe);
 static int                            Create_Display_Renderpass(void);
 static int                            Create_Display_Pipeline(void);
 static int                            Create_Copy_Renderpass(void);
@@ -122,24 +256,35 @@ static int                            Create_Copy_Pipeline(void);
 static int                            Create_Window_Framebuffer(void);
 static int                            Create_Float_Image_And_Framebuffer(void);
 static int                            Create_Skybox_Image(void);
+static int                            Open_Texture_Sources(void);
+static int                            Create_Offscreen_Images(void);
 static int                            Create_Palette_Images(void);
-static int                            Init_Particle_Thread(THREAD_DATA *thrd);
-static int                            Finish_Particle_Thread(THREAD_DATA *thrd);
-static int                            Release_Particle_Thread(THREAD_DATA *thrd);
-static int                            Update_Particle_Thread(THREAD_DATA *thrd);
-static int                            SDLCALL Particle_Thread(void *data);
+static int                            Upload_Textures(void);
+static int                            Init_Particle_Chunk(PARTICLE_CHUNK *chunk);
+static int                            Release_Particle_Chunk(PARTICLE_CHUNK *chunk);
+static int                            Update_Particle_Chunk(PARTICLE_CHUNK *chunk);
+static void                           Particle_Job(void *data, int job_index, int worker_index);
+static void                           Particle_Thread_Init(int worker_index);
+static void                           Particle_Seed_Job(void *data, int job_index, int worker_index);
+static int                            Is_Particle_Recording_Current(void);
+static void                           Store_Particle_Recording(void);
+static void                           Cmd_Draw_Particles(VkCommandBuffer cmdbuf, PARTICLE_CHUNK *chunk);
+static void                           Cmd_Execute_Particle_Chunks(VkCommandBuffer cmdbuf);
 static void                           Cmd_Clear(VkCommandBuffer cmdbuf);
 static void                           Cmd_Begin_Win_RenderPass(VkCommandBuffer cmdbuf);
 static void                           Cmd_End_Win_RenderPass(VkCommandBuffer cmdbuf);
 static void                           Cmd_Display_Fractal(VkCommandBuffer cmdbuf);
 static void                           Cmd_Render_Skybox(VkCommandBuffer cmdbuf);
+static void                           Cmd_Evaluate_Particles(VkCommandBuffer cmdbuf);
+static int                            Create_Timestamp_Pool(void);
+static void                           Cmd_Begin_Gpu_Pass(VkCommandBuffer cmdbuf, int pass);
+static void                           Cmd_End_Gpu_Pass(VkCommandBuffer cmdbuf, int pass);
+static void                           Read_Timestamps(void);
 //-----------------------------------------------------------------------------
 static int                            Graph_Init(GRAPH *graph, struct graph_data_t *data, int x, int y, int w, int h, float color[4], int draw_background);
-static void                           Graph_Release(GRAPH *graph);
 static void                           Graph_Draw(GRAPH *graph, VkCommandBuffer cmdbuf);
 static int                            Graph_Update_Buffer(GRAPH *graph, struct graph_data_t* data);
 //-----------------------------------------------------------------------------
-static int                            Create_Common_Graph_Resources(void);
 static int                            Update_Common_Graph_Resources(void);
 static int                            Create_Graph_Pipeline(VkPrimitiveTopology topology, VkPipeline *pipe);
 //-----------------------------------------------------------------------------
@@ -149,6 +294,8 @@ static int                            Generate_Text(void);
 static void                           Cmd_Draw_Text(VkCommandBuffer cmdbuf);
 //-----------------------------------------------------------------------------
 static uint32_t                       Get_Mem_Type_Index(VkMemoryPropertyFlagBits bit);
+static int                            Get_UMA_Mem_Type_Index(uint32_t type_bits, uint32_t *index);
+static int                            Find_Mem_Type_Index(uint32_t type_bits, VkMemoryPropertyFlags flags, uint32_t *index);
 //-----------------------------------------------------------------------------
 static int                            s_exit_code;
 static __inline int                   Set_Exit_Code(int exit_code)
@@ -168,7 +315,27 @@ static VkDevice                         s_gpu_device;
 static VkQueue                          s_gpu_queue;
 static VkPhysicalDevice                 s_gpu;
 static VkPhysicalDeviceProperties       s_gpu_properties;
+static VkPhysicalDeviceFeatures         s_gpu_features;
+static VkPipelineCache                  s_pipeline_cache;
+static int                              s_pipeline_count;
+static Uint64                           s_pipeline_ticks;
+static SDL_SpinLock                     s_pipeline_stats_lock;
 static VkImage                          s_win_images[k_Window_Buffering];
+static int                              s_headless;
+static const char                       *s_phase_name[PHASE_COUNT] = {
+    "fence_wait", "update", "record", "acquire", "particle_wait", "submit", "present"
+};
+static const char                       *s_gpu_pass_name[GPU_PASS_COUNT] = {
+    "frame", "clear", "skybox", "compute", "particles", "display", "hud"
+};
+static VkQueryPool                      s_timestamp_pool;
+static uint64_t                         s_timestamp_mask;
+static int                              s_timestamp_pending[k_Resource_Buffering];
+static float                            s_gpu_ms[GPU_PASS_COUNT];
+static float                            s_gpu_graph_sum;
+static int                              s_gpu_graph_count;
+static GRAPH                            s_gpu_graph;
+static struct graph_data_t              s_gpu_graph_data;
 static VkImageView                      s_win_image_view[k_Window_Buffering];
 static VkFramebuffer                    s_win_framebuffer[k_Window_Buffering];
 static VkRenderPass                     s_win_renderpass;
@@ -183,15 +350,32 @@ static VKU_IMAGE_MEMORY_POOL            *s_image_mempool_texture;
 static VkCommandPool                    s_command_pool;
 static VkCommandBuffer                  s_cmdbuf_display[k_Resource_Buffering];
 static VkCommandBuffer                  s_cmdbuf_clear[k_Resource_Buffering];
+static VkCommandBuffer                  s_cmdbuf_particle[k_Resource_Buffering];
 static VkFence                          s_fence[k_Resource_Buffering];
 static VkDescriptorPool                 s_common_dpool;
 static VkDescriptorSetLayout            s_common_dset_layout;
 static VkPipelineLayout                 s_common_pipeline_layout;
-static VkDescriptorSet                  s_common_dset[k_Resource_Buffering];
-static VkDeviceMemory                   s_constant_mem[k_Resource_Buffering];
-static VkBuffer                         s_constant_buf[k_Resource_Buffering];
+static VkDescriptorSet                  s_common_dset[k_Resource_Buffering][k_Palette_Count];
+static VkDescriptorSet                  s_frame_dset;
+static VkDeviceMemory                   s_upload_mem;
+static VkBuffer                         s_upload_buf;
+static uint8_t                          *s_upload_ptr;
+static VkDeviceSize                     s_upload_head;
+static VkDeviceSize                     s_upload_end;
+static uint32_t                         s_constant_offset;
+static void                             *s_constant_ptr;
+static int                              s_push_constants;
+static PUSH_CONSTANT                    s_push_constant;
 static VkDeviceMemory                   s_particle_seed_mem;
 static VkBuffer                         s_particle_seed_buf;
+static VkDeviceMemory                   s_particle_indirect_mem;
+static VkBuffer                         s_particle_indirect_buf;
+static VkBuffer                         s_particle_cache_buf;
+static uint32_t                         s_particle_cache_seed;
+static float                            s_particle_cache_factor;
+static int                              s_particle_cache_valid;
+static VkPipeline                       s_particle_evaluate_pipe;
+static VkPipeline                       s_particle_cached_pipe;
 static VkPipeline                       s_particle_pipe;
 static VkImage                          s_float_image;
 static VkImageView                      s_float_image_view;
@@ -205,7 +389,6 @@ static VkImage                          s_skybox_image;
 static VkImageView                      s_skybox_image_view;
 static VkPipeline                       s_skybox_pipe;
 static VkPipeline                       s_skybox_generate_pipe;
-static VkDeviceMemory                   s_skybox_mem;
 static VkBuffer                         s_skybox_buf;
 static VkRenderPass                     s_copy_renderpass;
 static VkPipeline                       s_copy_image_pipe;
@@ -219,11 +402,34 @@ static VmathMatrix4                     s_transform_a[3];
 static VmathMatrix4                     s_transform_b[3];
 static VkImage                          s_palette_image[6];
 static VkImageView                      s_palette_image_view[6];
-static THREAD_DATA                      s_thread[MAX_CPU_CORES];
-static SDL_sem                          *s_cmdgen_sem[MAX_CPU_CORES];
+static const TEXTURE_DESC               s_texture_desc[k_Texture_Source_Count] = {
+    {
+        "Data/Texture/Skybox.sdtx", {
+            "Data/Texture/Skybox_right1.png", "Data/Texture/Skybox_left2.png",
+            "Data/Texture/Skybox_top3.png", "Data/Texture/Skybox_bottom4.png",
+            "Data/Texture/Skybox_front5.png", "Data/Texture/Skybox_back6.png"
+        }, 6, 1024, 1024
+    },
+    { "Data/Texture/Palette_Fire.sdtx", { "Data/Texture/Palette_Fire.png" }, 1, 256, 1 },
+    { "Data/Texture/Palette_Purple.sdtx", { "Data/Texture/Palette_Purple.png" }, 1, 256, 1 },
+    { "Data/Texture/Palette_Muted.sdtx", { "Data/Texture/Palette_Muted.png" }, 1, 256, 1 },
+    { "Data/Texture/Palette_Rainbow.sdtx", { "Data/Texture/Palette_Rainbow.png" }, 1, 256, 1 },
+    { "Data/Texture/Palette_Sky.sdtx", { "Data/Texture/Palette_Sky.png" }, 1, 256, 1 },
+    { "Data/Texture/Palette_Sky.sdtx", { "Data/Texture/Palette_Sky.png" }, 1, 256, 1 }
+};
+static TEXTURE_SOURCE                   s_texture_source[k_Texture_Source_Count];
+static PARTICLE_CHUNK                   *s_chunk;
+static int                              s_chunk_count;
+static VkCommandBuffer                  *s_cmdbuf_list;
+static PARTICLE_RECORDING               s_particle_recording[k_Resource_Buffering];
+static int                              s_particle_secondary;
+static int                              s_particle_draw_mode;
+static int                              s_particle_cached;
+static int                              s_particle_recording_pending;
 static uint32_t                         s_queue_family_index;
 static VkSwapchainKHR                   s_swap_chain;
-static VkSemaphore                      s_swap_chain_image_ready_semaphore;
+static VkSemaphore                      s_image_acquired_semaphore[k_Resource_Buffering];
+static VkSemaphore                      s_render_done_semaphore[k_Resource_Buffering];
 static ViewportState                    s_vp_state;
 static ViewportState                    s_vp_state_copy_skybox;
 static ViewportState                    s_vp_state_copy_palette;
@@ -233,18 +439,17 @@ static RasterState                      s_rs_state;
 static ColorBlendState                  s_cb_state;
 static DepthStencilState                s_ds_state;
 //-------------------------------------------------------------------------------
-static VkDeviceMemory                   s_graph_buffer_mem[k_Resource_Buffering];
-static VkBuffer                         s_graph_buffer[k_Resource_Buffering];
+static VkDeviceSize                     s_graph_common_offset;
 static VkPipeline                       s_graph_tri_strip_pipe;
 static VkPipeline                       s_graph_line_list_pipe;
 static VkPipeline                       s_graph_line_strip_pipe;
-static GRAPH                            s_graph[MAX_CPU_CORES];
+static GRAPH                            *s_graph;
+static int                              s_graph_count;
 //-------------------------------------------------------------------------------
 static VkImage                          s_font_image;
 static VkImageView                      s_font_image_view;
 static VkDeviceMemory                   s_font_image_mem;
-static VkBuffer                         s_font_buffer[k_Resource_Buffering];
-static VkDeviceMemory                   s_font_buffer_mem[k_Resource_Buffering];
+static VkDeviceSize                     s_font_offset;
 static VkPipeline                       s_font_pipe;
 static stb_fontchar                     s_font_24_data[STB_FONT_consolas_24_usascii_NUM_CHARS];
 static int                              s_font_letter_count;
@@ -256,6 +461,113 @@ static int                              s_font_letter_count;
 #define VM_PIDIV2 1.570796327f
 #define VM_PIDIV4 0.785398163f
 //=============================================================================
+static int Init_Particle_Pipeline(void)
+{
+    if (s_push_constants && !Create_Particle_Pipeline("Data/Shader_GLSL/VS_Particle_Draw_Push.spv", 1, &s_particle_pipe)) {
+        Log("VS_Particle_Draw_Push.spv not found, push constants disabled\n");
+        s_push_constants = 0;
+    }
+    if (!s_particle_pipe && !Create_Particle_Pipeline("Data/Shader_GLSL/VS_Particle_Draw.spv", 1, &s_particle_pipe)) LOG_AND_RETURN0();
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+static int Init_Particle_Cached_Pipeline(void)
+{
+    // optional, without the shader cached positions fall back to evaluating in VS_Particle_Draw
+    if (!Create_Particle_Pipeline("Data/Shader_GLSL/VS_Particle_Cached.spv", 0, &s_particle_cached_pipe)) {
+        Log("VS_Particle_Cached.spv not found, cached positions disabled\n");
+    }
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+static int Init_Particle_Evaluate_Pipeline(void)
+{
+    return Create_Particle_Compute_Pipeline("Data/Shader_GLSL/CS_Particle_Evaluate.spv", &s_particle_evaluate_pipe);
+}
+//-----------------------------------------------------------------------------
+static int Init_Graph_Tri_Strip_Pipeline(void)
+{
+    return Create_Graph_Pipeline(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, &s_graph_tri_strip_pipe);
+}
+//-----------------------------------------------------------------------------
+static int Init_Graph_Line_Strip_Pipeline(void)
+{
+    return Create_Graph_Pipeline(VK_PRIMITIVE_TOPOLOGY_LINE_STRIP, &s_graph_line_strip_pipe);
+}
+//-----------------------------------------------------------------------------
+static int Init_Graph_Line_List_Pipeline(void)
+{
+    return Create_Graph_Pipeline(VK_PRIMITIVE_TOPOLOGY_LINE_LIST, &s_graph_line_list_pipe);
+}
+//=============================================================================
+#define INIT_PIPELINE_DEPS (INIT_DEP(INIT_COMMON_DSET) | INIT_DEP(INIT_DYNAMIC_STATES))
+
+// Indexed by the INIT_* enum. The particle pipeline decides s_push_constants, which selects the
+// shaders of the cached particle and skybox pipelines.
+static const INIT_TASK s_init_task[INIT_TASK_COUNT] = {
+    { "Create_Common_Dset", Create_Common_Dset, 0 },
+    { "Init_Dynamic_States", Init_Dynamic_States, 0 },
+    { "Create_Float_Renderpass", Create_Float_Renderpass, 0 },
+    { "Create_Display_Renderpass", Create_Display_Renderpass, 0 },
+    { "Create_Copy_Renderpass", Create_Copy_Renderpass, 0 },
+    { "Init_Particle_Pipeline", Init_Particle_Pipeline, INIT_PIPELINE_DEPS | INIT_DEP(INIT_FLOAT_RENDERPASS) },
+    { "Init_Particle_Cached_Pipeline", Init_Particle_Cached_Pipeline, INIT_PIPELINE_DEPS | INIT_DEP(INIT_FLOAT_RENDERPASS) | INIT_DEP(INIT_PARTICLE_PIPELINE) },
+    { "Init_Particle_Evaluate_Pipeline", Init_Particle_Evaluate_Pipeline, INIT_DEP(INIT_COMMON_DSET) },
+    { "Create_Display_Pipeline", Create_Display_Pipeline, INIT_PIPELINE_DEPS | INIT_DEP(INIT_DISPLAY_RENDERPASS) },
+    { "Init_Graph_Tri_Strip_Pipeline", Init_Graph_Tri_Strip_Pipeline, INIT_PIPELINE_DEPS | INIT_DEP(INIT_DISPLAY_RENDERPASS) },
+    { "Init_Graph_Line_Strip_Pipeline", Init_Graph_Line_Strip_Pipeline, INIT_PIPELINE_DEPS | INIT_DEP(INIT_DISPLAY_RENDERPASS) },
+    { "Init_Graph_Line_List_Pipeline", Init_Graph_Line_List_Pipeline, INIT_PIPELINE_DEPS | INIT_DEP(INIT_DISPLAY_RENDERPASS) },
+    { "Create_Copy_Pipeline", Create_Copy_Pipeline, INIT_PIPELINE_DEPS | INIT_DEP(INIT_COPY_RENDERPASS) },
+    { "Create_Font_Pipeline", Create_Font_Pipeline, INIT_PIPELINE_DEPS | INIT_DEP(INIT_DISPLAY_RENDERPASS) },
+    { "Create_Skybox_Pipeline", Create_Skybox_Pipeline, INIT_PIPELINE_DEPS | INIT_DEP(INIT_FLOAT_RENDERPASS) | INIT_DEP(INIT_PARTICLE_PIPELINE) },
+    { "Create_Skybox_Generate_Pipeline", Create_Skybox_Generate_Pipeline, INIT_DEP(INIT_COMMON_DSET) },
+};
+static int                              s_init_task_result[INIT_TASK_COUNT];
+//-----------------------------------------------------------------------------
+static void Init_Task_Job(void *data, int job_index, int worker_index)
+{
+    (void)worker_index;
+    const int *wave = data;
+    s_init_task_result[wave[job_index]] = s_init_task[wave[job_index]].func();
+}
+//-----------------------------------------------------------------------------
+// Runs the render pass, layout and pipeline creation as a dependency graph. Every task whose
+// dependencies are done joins the next wave, and a wave runs in parallel on the job workers.
+// A task only writes its own handles, so the result does not depend on which worker finishes
+// first, and failures are reported in table order.
+static int Run_Init_Tasks(void)
+{
+    uint32_t done = 0;
+
+    while (done != INIT_DEP(INIT_TASK_COUNT) - 1) {
+        int wave[INIT_TASK_COUNT];
+        int wave_count = 0;
+
+        for (int i = 0; i < INIT_TASK_COUNT; ++i) {
+            if (!(done & INIT_DEP(i)) && !(s_init_task[i].depends & ~done)) wave[wave_count++] = i;
+        }
+        if (!wave_count) LOG_AND_RETURN0();
+
+#ifdef MT_UPDATE
+        if (!Jobs_Submit(Init_Task_Job, wave, wave_count)) LOG_AND_RETURN0();
+        Jobs_Wait();
+#else
+        for (int i = 0; i < wave_count; ++i) Init_Task_Job(wave, i, 0);
+#endif
+        for (int i = 0; i < wave_count; ++i) {
+            if (!s_init_task_result[wave[i]]) {
+                Log("%s failed\n", s_init_task[wave[i]].name);
+                LOG_AND_RETURN0();
+            }
+            done |= INIT_DEP(wave[i]);
+        }
+    }
+
+    return 1;
+}
+//=============================================================================
 static int Demo_Init(void)
 {
     s_font_letter_count = 0;
@@ -277,45 +589,45 @@ static int Demo_Init(void)
     };
     VKU_VR(vkAllocateCommandBuffers(s_gpu_device, &cmdbuf_info, s_cmdbuf_display));
     VKU_VR(vkAllocateCommandBuffers(s_gpu_device, &cmdbuf_info, s_cmdbuf_clear));
+    VKU_VR(vkAllocateCommandBuffers(s_gpu_device, &cmdbuf_info, s_cmdbuf_particle));
+
+    VkSemaphoreCreateInfo semaphore_info = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, NULL, 0 };
+    for (int i = 0; i < k_Resource_Buffering; ++i) {
+        VKU_VR(vkCreateSemaphore(s_gpu_device, &semaphore_info, NO_ALLOC_CALLBACK, &s_image_acquired_semaphore[i]));
+        VKU_VR(vkCreateSemaphore(s_gpu_device, &semaphore_info, NO_ALLOC_CALLBACK, &s_render_done_semaphore[i]));
+    }
+
+    // Pools only reserve address space here, blocks are allocated on first use per memory type.
+    // Render targets at high resolutions exceed half a target block and get dedicated memory.
+    VkDeviceSize granularity = s_gpu_properties.limits.bufferImageGranularity;
 
     /* render targets object pool */ {
-        VkMemoryAllocateInfo alloc_info = {
-            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, VKU_ALIGN_PAGE(s_glob_state->width * s_glob_state->height * 32),
-            Get_Mem_Type_Index(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
-        };
-        if (!VKU_Create_Buffer_Memory_Pool(s_gpu_device, s_gpu_queue, &alloc_info, &s_buffer_mempool_target))
+        if (!VKU_Create_Buffer_Memory_Pool(s_gpu_device, s_gpu_queue, 1024 * 1024 * 16, &s_buffer_mempool_target))
             LOG_AND_RETURN0();
-        if (!VKU_Create_Image_Memory_Pool(s_gpu_device, s_gpu_queue, &alloc_info, &s_image_mempool_target))
+        if (!VKU_Create_Image_Memory_Pool(s_gpu_device, s_gpu_queue, 1024 * 1024 * 16, granularity, &s_image_mempool_target))
             LOG_AND_RETURN0();
     }
     /* state objects pool */ {
-        VkMemoryAllocateInfo alloc_info = {
-            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, 1024 * 1024 * 8,
-            Get_Mem_Type_Index(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
-        };
-        if (!VKU_Create_Buffer_Memory_Pool(s_gpu_device, s_gpu_queue, &alloc_info, &s_buffer_mempool_state))
+        if (!VKU_Create_Buffer_Memory_Pool(s_gpu_device, s_gpu_queue, 1024 * 1024 * 8, &s_buffer_mempool_state))
             LOG_AND_RETURN0();
-        if (!VKU_Create_Image_Memory_Pool(s_gpu_device, s_gpu_queue, &alloc_info, &s_image_mempool_state))
+        if (!VKU_Create_Image_Memory_Pool(s_gpu_device, s_gpu_queue, 1024 * 1024 * 8, granularity, &s_image_mempool_state))
             LOG_AND_RETURN0();
     }
     /* texture pool */ {
-        VkMemoryAllocateInfo alloc_info = {
-            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, 1024 * 1024 * 32,
-            Get_Mem_Type_Index(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
-        };
-        if (!VKU_Create_Buffer_Memory_Pool(s_gpu_device, s_gpu_queue, &alloc_info, &s_buffer_mempool_texture))
+        if (!VKU_Create_Buffer_Memory_Pool(s_gpu_device, s_gpu_queue, 1024 * 1024 * 32, &s_buffer_mempool_texture))
             LOG_AND_RETURN0();
-        if (!VKU_Create_Image_Memory_Pool(s_gpu_device, s_gpu_queue, &alloc_info, &s_image_mempool_texture))
+        if (!VKU_Create_Image_Memory_Pool(s_gpu_device, s_gpu_queue, 1024 * 1024 * 32, granularity, &s_image_mempool_texture))
             LOG_AND_RETURN0();
     }
 
     VkSamplerCreateInfo sampler_info0 = {
         VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO, NULL, 0,
-        VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR,
         VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-        VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, 0.0f, VK_FALSE, 0, VK_FALSE, VK_COMPARE_OP_ALWAYS, 0.0f, 0.0f,
+        VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, 0.0f, VK_FALSE, 0, VK_FALSE, VK_COMPARE_OP_ALWAYS, 0.0f, 1000.0f,
         VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE, VK_FALSE
     };
+    // maxLod is VK_LOD_CLAMP_NONE, the skybox container may carry a mip chain
     VKU_VR(vkCreateSampler(s_gpu_device, &sampler_info0, NO_ALLOC_CALLBACK, &s_sampler));
 
     VkSamplerCreateInfo sampler_info1 = {
@@ -336,48 +648,84 @@ static int Demo_Init(void)
     };
     VKU_VR(vkCreateSampler(s_gpu_device, &sampler_info2, NO_ALLOC_CALLBACK, &s_sampler_nearest));
 
+#ifdef MT_UPDATE
+    // started before Create_Particles, which spreads the seed generation over the workers,
+    // Run_Init_Tasks, which may submit every init task in a single wave, and Upload_Textures
+    if (!Jobs_Init(s_glob_state->cpu_core_count,
+                   SDL_max(s_glob_state->cpu_core_count * k_Particle_Chunks_Per_Worker,
+                           SDL_max(INIT_TASK_COUNT, k_Texture_Upload_Count)),
+                   Particle_Thread_Init)) LOG_AND_RETURN0();
+#endif
+    // thread 0 is the main thread, the others are the job workers
+    if (!Trace_Init(s_glob_state->cpu_core_count, k_Trace_Events_Per_Thread)) LOG_AND_RETURN0();
+
+    s_push_constants = s_glob_state->push_constants;
+
+    size_t cache_size;
+    if (!VKU_Load_Pipeline_Cache(s_gpu_device, s_gpu, k_Pipeline_Cache_File, &s_pipeline_cache, &cache_size)) LOG_AND_RETURN0();
+    Log("Pipeline cache: %s (%u bytes)\n", cache_size ? "loaded" : "empty", (unsigned)cache_size);
+
     if (!Create_Depth_Stencil()) LOG_AND_RETURN0();
-    if (!Create_Common_Dset()) LOG_AND_RETURN0();
     if (!Create_Particles()) LOG_AND_RETURN0();
-    if (!Create_Float_Renderpass()) LOG_AND_RETURN0();
-    if (!Init_Dynamic_States()) LOG_AND_RETURN0();
-    if (!Create_Particle_Pipeline()) LOG_AND_RETURN0();
-    if (!Create_Display_Renderpass()) LOG_AND_RETURN0();
-    if (!Create_Display_Pipeline()) LOG_AND_RETURN0();
-    if (!Create_Graph_Pipeline(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, &s_graph_tri_strip_pipe)) LOG_AND_RETURN0();
-    if (!Create_Graph_Pipeline(VK_PRIMITIVE_TOPOLOGY_LINE_STRIP, &s_graph_line_strip_pipe)) LOG_AND_RETURN0();
-    if (!Create_Graph_Pipeline(VK_PRIMITIVE_TOPOLOGY_LINE_LIST, &s_graph_line_list_pipe)) LOG_AND_RETURN0();
+    if (!Create_Particle_Indirect_Buffer()) LOG_AND_RETURN0();
+
+    Uint64 init_begin = SDL_GetPerformanceCounter();
+    if (!Run_Init_Tasks()) LOG_AND_RETURN0();
+    Log("Pipelines: %d created in %.1f ms, %.1f ms wall time\n", s_pipeline_count,
+        1000.0 * s_pipeline_ticks / SDL_GetPerformanceFrequency(),
+        1000.0 * (SDL_GetPerformanceCounter() - init_begin) / SDL_GetPerformanceFrequency());
+
+    // after the pipelines, which decide whether the cache can be used at all
+    if (!Create_Particle_Cache_Buffer()) LOG_AND_RETURN0();
+
+    if (s_headless && !Create_Offscreen_Images()) LOG_AND_RETURN0();
     if (!Create_Window_Framebuffer()) LOG_AND_RETURN0();
-    if (!Create_Constant_Memory()) LOG_AND_RETURN0();
+    if (!Create_Upload_Ring()) LOG_AND_RETURN0();
     if (!Create_Float_Image_And_Framebuffer()) LOG_AND_RETURN0();
-    if (!Create_Copy_Renderpass()) LOG_AND_RETURN0();
-    if (!Create_Copy_Pipeline()) LOG_AND_RETURN0();
     if (!Create_Font_Resources()) LOG_AND_RETURN0();
-    if (!Create_Font_Pipeline()) LOG_AND_RETURN0();
     if (!Create_Skybox_Geometry()) LOG_AND_RETURN0();
-    if (!Create_Skybox_Pipeline()) LOG_AND_RETURN0();
-    if (!Create_Skybox_Generate_Pipeline()) LOG_AND_RETURN0();
+    if (!Open_Texture_Sources()) LOG_AND_RETURN0();
     if (!Create_Skybox_Image()) LOG_AND_RETURN0();
     if (!Create_Palette_Images()) LOG_AND_RETURN0();
-    if (!Create_Common_Graph_Resources()) LOG_AND_RETURN0();
+    if (!Upload_Textures()) LOG_AND_RETURN0();
+
+    for (int i = 0; i < k_Resource_Buffering; ++i) {
+        for (int j = 0; j < k_Palette_Count; ++j) Write_Common_Dset(s_common_dset[i][j], j);
+    }
 
     float green[4] = { 0.0f, 0.85f, 0.0f, 1.0f };
 
-    // cpu load graphs
-    for (int i = 0; i < s_glob_state->cpu_core_count; ++i) {
+    // cpu load graphs, as many as fit the window height
+    s_graph_count = SDL_min(s_glob_state->cpu_core_count, SDL_max(1, (s_glob_state->height - 36) / 92));
+    s_graph = calloc(s_graph_count, sizeof(*s_graph));
+    if (!s_graph) LOG_AND_RETURN0();
+
+    for (int i = 0; i < s_graph_count; ++i) {
         if (!Graph_Init(&s_graph[i], &s_glob_state->graph_data[i], s_glob_state->width - 10 - k_Graph_Width, 36 + i * 92,
                         k_Graph_Width, 88, green, 1)) return 0;
     }
 
-    s_glob_state->palette_image_idx %= 5;
-
-    for (int i = 0; i < s_glob_state->cpu_core_count; ++i) {
-        s_cmdgen_sem[i] = SDL_CreateSemaphore(0);
-        if (!s_cmdgen_sem[i]) LOG_AND_RETURN0();
+    // GPU frame time, left of the cpu load graphs
+    if (!Create_Timestamp_Pool()) LOG_AND_RETURN0();
+    if (s_timestamp_pool) {
+        float orange[4] = { 1.0f, 0.55f, 0.0f, 1.0f };
+        s_gpu_graph_data.empty_flag = 1;
+        s_gpu_graph_data.scale = 1.0f;
+        if (!Graph_Init(&s_gpu_graph, &s_gpu_graph_data, s_glob_state->width - 20 - 2 * k_Graph_Width, 36,
+                        k_Graph_Width, 88, orange, 1)) return 0;
     }
-    for (int i = 0; i < s_glob_state->cpu_core_count; ++i) {
-        s_thread[i].tid = i;
-        if (!Init_Particle_Thread(&s_thread[i])) LOG_AND_RETURN0();
+
+    s_glob_state->palette_image_idx %= k_Palette_Count;
+
+    s_chunk_count = s_glob_state->cpu_core_count * k_Particle_Chunks_Per_Worker;
+    s_chunk = calloc(s_chunk_count, sizeof(*s_chunk));
+    s_cmdbuf_list = calloc(2 + s_chunk_count, sizeof(*s_cmdbuf_list));
+    if (!s_chunk || !s_cmdbuf_list) LOG_AND_RETURN0();
+
+    for (int i = 0; i < s_chunk_count; ++i) {
+        s_chunk[i].first_draw = (int)((int64_t)DRAW_COUNT * i / s_chunk_count);
+        s_chunk[i].draw_count = (int)((int64_t)DRAW_COUNT * (i + 1) / s_chunk_count) - s_chunk[i].first_draw;
+        if (!Init_Particle_Chunk(&s_chunk[i])) LOG_AND_RETURN0();
     }
 
     return 1;
@@ -387,13 +735,27 @@ static int Demo_Shutdown(void)
 {
     if (s_gpu_device) vkDeviceWaitIdle(s_gpu_device);
 
-    for (int i = 0; i < s_glob_state->cpu_core_count; ++i) {
-        Release_Particle_Thread(&s_thread[i]);
+#ifdef MT_UPDATE
+    Jobs_Shutdown();
+#endif
+    Trace_Shutdown();
+
+    if (s_pipeline_cache) {
+        size_t cache_size;
+        if (VKU_Save_Pipeline_Cache(s_gpu_device, s_pipeline_cache, k_Pipeline_Cache_File, &cache_size)) {
+            Log("Pipeline cache saved (%u bytes)\n", (unsigned)cache_size);
+        }
+        VKU_DESTROY(vkDestroyPipelineCache, s_pipeline_cache);
     }
-    for (int i = 0; i < s_glob_state->cpu_core_count; ++i) {
-        SDL_DestroySemaphore(s_cmdgen_sem[i]);
-        s_cmdgen_sem[i] = NULL;
+
+    for (int i = 0; s_chunk && i < s_chunk_count; ++i) {
+        Release_Particle_Chunk(&s_chunk[i]);
     }
+    free(s_chunk);
+    free(s_cmdbuf_list);
+    s_chunk = NULL;
+    s_cmdbuf_list = NULL;
+    s_chunk_count = 0;
     VKU_Free_Buffer_Memory_Pool(s_buffer_mempool_state);
     VKU_Free_Buffer_Memory_Pool(s_buffer_mempool_target);
     VKU_Free_Buffer_Memory_Pool(s_buffer_mempool_texture);
@@ -410,14 +772,22 @@ static int Demo_Shutdown(void)
 
     VKU_DESTROY(vkDestroyBuffer, s_particle_seed_buf);
     VKU_FREE_MEM(s_particle_seed_mem);
+    VKU_DESTROY(vkDestroyBuffer, s_particle_indirect_buf);
+    VKU_FREE_MEM(s_particle_indirect_mem);
+    VKU_DESTROY(vkDestroyBuffer, s_particle_cache_buf);
+    VKU_DESTROY(vkDestroyPipeline, s_particle_evaluate_pipe);
+    VKU_DESTROY(vkDestroyPipeline, s_particle_cached_pipe);
 
-    for (int i = 0; i < k_Resource_Buffering; ++i) {
-        VKU_DESTROY(vkDestroyBuffer, s_constant_buf[i]);
-        VKU_FREE_MEM(s_constant_mem[i]);
+    VKU_DESTROY(vkDestroyBuffer, s_upload_buf);
+    VKU_FREE_MEM(s_upload_mem);
+    s_upload_ptr = NULL;
+    s_constant_ptr = NULL;
 
+    for (int i = 0; i < k_Resource_Buffering; ++i) {
         VKU_DESTROY(vkDestroyFence, s_fence[i]);
         VKU_FREE_CMD_BUF(s_command_pool, k_Resource_Buffering, s_cmdbuf_clear);
         VKU_FREE_CMD_BUF(s_command_pool, k_Resource_Buffering, s_cmdbuf_display);
+        VKU_FREE_CMD_BUF(s_command_pool, k_Resource_Buffering, s_cmdbuf_particle);
     }
     VKU_DESTROY(vkDestroyPipelineLayout, s_common_pipeline_layout);
     VKU_DESTROY(vkDestroyDescriptorSetLayout, s_common_dset_layout);
@@ -441,118 +811,247 @@ static int Demo_Shutdown(void)
     VKU_DESTROY(vkDestroyBuffer, s_skybox_buf);
     VKU_DESTROY(vkDestroyPipeline, s_skybox_pipe);
     VKU_DESTROY(vkDestroyPipeline, s_skybox_generate_pipe);
-    VKU_FREE_MEM(s_skybox_mem);
     for (int i = 0; i < SDL_arraysize(s_palette_image); ++i) {
         VKU_DESTROY(vkDestroyImageView, s_palette_image_view[i]);
         VKU_DESTROY(vkDestroyImage, s_palette_image[i]);
     }
+    for (int i = 0; i < k_Texture_Source_Count; ++i) Texture_File_Close(&s_texture_source[i].file);
 
     VKU_DESTROY(vkDestroyImageView, s_font_image_view);
     VKU_DESTROY(vkDestroyImage, s_font_image);
     VKU_FREE_MEM(s_font_image_mem);
     VKU_DESTROY(vkDestroyPipeline, s_font_pipe);
 
-    for (int i = 0; i < k_Resource_Buffering; ++i) {
-        VKU_DESTROY(vkDestroyBuffer, s_graph_buffer[i]);
-        VKU_FREE_MEM(s_graph_buffer_mem[i]);
-        VKU_DESTROY(vkDestroyBuffer, s_font_buffer[i]);
-        VKU_FREE_MEM(s_font_buffer_mem[i]);
-    }
-    for (int i = 0; i < s_glob_state->cpu_core_count; ++i) Graph_Release(&s_graph[i]);
+    free(s_graph);
+    s_graph = NULL;
+    s_graph_count = 0;
+    VKU_DESTROY(vkDestroyQueryPool, s_timestamp_pool);
 
     for (int i = 0; i < k_Window_Buffering; ++i) {
         VKU_DESTROY(vkDestroyFramebuffer, s_win_framebuffer[i]);
         VKU_DESTROY(vkDestroyImageView, s_win_image_view[i]);
+        // swapchain images belong to the swapchain
+        if (s_headless) VKU_DESTROY(vkDestroyImage, s_win_images[i]);
     }
     VKU_DESTROY(vkDestroyRenderPass, s_win_renderpass);
     VKU_DESTROY(vkDestroyImageView, s_depth_stencil_view);
     VKU_DESTROY(vkDestroyImage, s_depth_stencil_image);
 
     VKU_DESTROY(vkDestroyCommandPool, s_command_pool);
-    VKU_DESTROY(vkDestroySemaphore, s_swap_chain_image_ready_semaphore);
+    for (int i = 0; i < k_Resource_Buffering; ++i) {
+        VKU_DESTROY(vkDestroySemaphore, s_image_acquired_semaphore[i]);
+        VKU_DESTROY(vkDestroySemaphore, s_render_done_semaphore[i]);
+    }
 
     return 1;
 }
 //=============================================================================
 static int Demo_Update(void)
 {
-    if (s_fence[s_res_idx]) {
-        VKU_VR(vkWaitForFences(s_gpu_device, 1, &s_fence[s_res_idx], VK_TRUE, 100000000));
+    Uint64 phase_begin = SDL_GetPerformanceCounter();
+    Uint64 trace_begin = phase_begin;
+
+    // with push constants Begin_Frame already produced the values recorded into the particle chunks
+    if (!s_push_constants) {
+        Update_Camera();
+        if (!Update_Constant_Memory()) LOG_AND_RETURN0();
+        trace_begin = Trace_End(0, "Update_Constant_Memory", trace_begin);
     }
 
-    Update_Camera();
-    if (!Update_Constant_Memory()) LOG_AND_RETURN0();
-    Update_Common_Dset();
-
-    for (int i = 0; i < s_glob_state->cpu_core_count; ++i) {
+    for (int i = 0; i < s_graph_count; ++i) {
         if (!Graph_Update_Buffer(&s_graph[i], &s_glob_state->graph_data[i])) LOG_AND_RETURN0();
     }
+    if (s_timestamp_pool && !Graph_Update_Buffer(&s_gpu_graph, &s_gpu_graph_data)) LOG_AND_RETURN0();
     if (!Update_Common_Graph_Resources()) LOG_AND_RETURN0();
+    trace_begin = Trace_End(0, "Update_Graphs", trace_begin);
     if (!Generate_Text()) LOG_AND_RETURN0();
-
-#ifdef MT_UPDATE
-    for (int i = 1; i < s_glob_state->cpu_core_count; ++i) {
-        SDL_SemPost(s_cmdgen_sem[i]);
-    }
-#endif
+    trace_begin = Trace_End(0, "Generate_Text", trace_begin);
+    phase_begin = Benchmark_End_Phase(PHASE_UPDATE, phase_begin);
 
     VkCommandBufferBeginInfo begin_info = {
         VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL, 0, NULL
     };
     VKU_VR(vkBeginCommandBuffer(s_cmdbuf_clear[s_res_idx], &begin_info));
+    Cmd_Begin_Gpu_Pass(s_cmdbuf_clear[s_res_idx], GPU_PASS_FRAME);
+    Cmd_Begin_Gpu_Pass(s_cmdbuf_clear[s_res_idx], GPU_PASS_CLEAR);
     Cmd_Clear(s_cmdbuf_clear[s_res_idx]);
+    Cmd_End_Gpu_Pass(s_cmdbuf_clear[s_res_idx], GPU_PASS_CLEAR);
+    Cmd_Begin_Gpu_Pass(s_cmdbuf_clear[s_res_idx], GPU_PASS_SKYBOX);
     Cmd_Render_Skybox(s_cmdbuf_clear[s_res_idx]);
+    Cmd_End_Gpu_Pass(s_cmdbuf_clear[s_res_idx], GPU_PASS_SKYBOX);
+    Cmd_Begin_Gpu_Pass(s_cmdbuf_clear[s_res_idx], GPU_PASS_COMPUTE);
+    if (s_particle_cached) Cmd_Evaluate_Particles(s_cmdbuf_clear[s_res_idx]);
+    Cmd_End_Gpu_Pass(s_cmdbuf_clear[s_res_idx], GPU_PASS_COMPUTE);
+    // the particle command buffers are submitted between the clear and the display command
+    // buffer, so the particle pass begins here and ends at the start of the display command buffer
+    Cmd_Begin_Gpu_Pass(s_cmdbuf_clear[s_res_idx], GPU_PASS_PARTICLES);
     VKU_VR(vkEndCommandBuffer(s_cmdbuf_clear[s_res_idx]));
+    trace_begin = Trace_End(0, "Record_Clear", trace_begin);
+    phase_begin = Benchmark_End_Phase(PHASE_RECORD, phase_begin);
+
+    // only the display pass touches the swapchain image, so acquire as late as possible. Headless
+    // the slot owns its offscreen image, Begin_Frame already waited on the fence of its last use.
+    if (s_headless) {
+        s_win_idx = s_res_idx;
+    } else {
+        uint32_t swap_image_index;
+        VKU_VR(vkAcquireNextImageKHR(s_gpu_device, s_swap_chain, UINT64_MAX,
+                                     s_image_acquired_semaphore[s_res_idx], VK_NULL_HANDLE, &swap_image_index));
+        s_win_idx = swap_image_index;
+        trace_begin = Trace_End(0, "vkAcquireNextImageKHR", trace_begin);
+    }
+    phase_begin = Benchmark_End_Phase(PHASE_ACQUIRE, phase_begin);
 
     VKU_VR(vkBeginCommandBuffer(s_cmdbuf_display[s_res_idx], &begin_info));
+    Cmd_End_Gpu_Pass(s_cmdbuf_display[s_res_idx], GPU_PASS_PARTICLES);
+    Cmd_Begin_Gpu_Pass(s_cmdbuf_display[s_res_idx], GPU_PASS_DISPLAY);
     Cmd_Begin_Win_RenderPass(s_cmdbuf_display[s_res_idx]);
     Cmd_Display_Fractal(s_cmdbuf_display[s_res_idx]);
-    for (int i = 0; i < s_glob_state->cpu_core_count; ++i) {
+    Cmd_End_Gpu_Pass(s_cmdbuf_display[s_res_idx], GPU_PASS_DISPLAY);
+    Cmd_Begin_Gpu_Pass(s_cmdbuf_display[s_res_idx], GPU_PASS_HUD);
+    for (int i = 0; i < s_graph_count; ++i) {
         Graph_Draw(&s_graph[i], s_cmdbuf_display[s_res_idx]);
     }
+    if (s_timestamp_pool) Graph_Draw(&s_gpu_graph, s_cmdbuf_display[s_res_idx]);
     Cmd_Draw_Text(s_cmdbuf_display[s_res_idx]);
+    Cmd_End_Gpu_Pass(s_cmdbuf_display[s_res_idx], GPU_PASS_HUD);
     Cmd_End_Win_RenderPass(s_cmdbuf_display[s_res_idx]);
+    Cmd_End_Gpu_Pass(s_cmdbuf_display[s_res_idx], GPU_PASS_FRAME);
     VKU_VR(vkEndCommandBuffer(s_cmdbuf_display[s_res_idx]));
-
-#ifdef MT_UPDATE
-    Update_Particle_Thread(&s_thread[0]);
-    for (int i = 1; i < s_glob_state->cpu_core_count; ++i) {
-        SDL_SemWait(s_thread[i].sem);
-    }
-#else
-    for (int i = 0; i < s_glob_state->cpu_core_count; ++i) {
-        Update_Particle_Thread(&s_thread[i]);
+    trace_begin = Trace_End(0, "Record_Display", trace_begin);
+    phase_begin = Benchmark_End_Phase(PHASE_RECORD, phase_begin);
+
+    if (!Finish_Particle_Recording()) LOG_AND_RETURN0();
+    trace_begin = Trace_End(0, "Finish_Particle_Recording", trace_begin);
+    phase_begin = Benchmark_End_Phase(PHASE_PARTICLE_WAIT, phase_begin);
+
+    if (s_particle_secondary) {
+        VKU_VR(vkBeginCommandBuffer(s_cmdbuf_particle[s_res_idx], &begin_info));
+        Cmd_Execute_Particle_Chunks(s_cmdbuf_particle[s_res_idx]);
+        VKU_VR(vkEndCommandBuffer(s_cmdbuf_particle[s_res_idx]));
+        trace_begin = Trace_End(0, "Record_Particle_Primary", trace_begin);
     }
-#endif
+    phase_begin = Benchmark_End_Phase(PHASE_RECORD, phase_begin);
 
     if (!s_fence[s_res_idx]) {
         VkFenceCreateInfo fence_info = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, NULL, 0 };
         VKU_VR(vkCreateFence(s_gpu_device, &fence_info, NO_ALLOC_CALLBACK, &s_fence[s_res_idx]));
     }
 
-    VkCommandBuffer cmdbuf[2 + MAX_CPU_CORES];
+    VkCommandBuffer *cmdbuf = s_cmdbuf_list;
     int cmdbuf_count = 0;
 
+    // chunks are submitted in draw order regardless of which worker recorded them
     cmdbuf[cmdbuf_count++] = s_cmdbuf_clear[s_res_idx];
-    for (int i = 0; i < s_glob_state->cpu_core_count; ++i) {
-        cmdbuf[cmdbuf_count++] = s_thread[i].cmdbuf[s_res_idx];
+    if (s_particle_secondary) {
+        cmdbuf[cmdbuf_count++] = s_cmdbuf_particle[s_res_idx];
+    } else {
+        for (int i = 0; i < s_chunk_count; ++i) {
+            cmdbuf[cmdbuf_count++] = s_chunk[i].cmdbuf[s_res_idx];
+        }
     }
     cmdbuf[cmdbuf_count++] = s_cmdbuf_display[s_res_idx];
 
     VKU_VR(vkResetFences(s_gpu_device, 1, &s_fence[s_res_idx]));
+    trace_begin = SDL_GetPerformanceCounter();
 
-    VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_HOST_BIT };
+    VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
     VkSubmitInfo submit_info;
     submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submit_info.pNext = NULL;
-    submit_info.waitSemaphoreCount = 1;
-    submit_info.pWaitSemaphores = &s_swap_chain_image_ready_semaphore;
+    submit_info.waitSemaphoreCount = s_headless ? 0 : 1;
+    submit_info.pWaitSemaphores = &s_image_acquired_semaphore[s_res_idx];
     submit_info.pWaitDstStageMask = wait_stages;
     submit_info.commandBufferCount = cmdbuf_count;
     submit_info.pCommandBuffers = cmdbuf;
-    submit_info.signalSemaphoreCount = 0;
-    submit_info.pSignalSemaphores = NULL;
+    submit_info.signalSemaphoreCount = s_headless ? 0 : 1;
+    submit_info.pSignalSemaphores = &s_render_done_semaphore[s_res_idx];
     VKU_VR(vkQueueSubmit(s_gpu_queue, 1, &submit_info, s_fence[s_res_idx]));
+    Trace_End(0, "vkQueueSubmit", trace_begin);
+    Benchmark_End_Phase(PHASE_SUBMIT, phase_begin);
+    Benchmark_Add_Draws(DRAW_COUNT);
+
+    return 1;
+}
+//=============================================================================
+// Waits until the GPU is done with the resource slot and starts recording its particle
+// command buffers on the job workers. Called right after the previous frame is submitted,
+// so the recording overlaps with its present.
+static int Begin_Frame(int res_idx)
+{
+    s_res_idx = res_idx;
+
+    if (s_fence[s_res_idx]) {
+        Uint64 wait_begin = SDL_GetPerformanceCounter();
+        VKU_VR(vkWaitForFences(s_gpu_device, 1, &s_fence[s_res_idx], VK_TRUE, UINT64_MAX));
+        Trace_End(0, "vkWaitForFences", wait_begin);
+        Benchmark_End_Phase(PHASE_FENCE_WAIT, wait_begin);
+    }
+    Reset_Upload_Ring();
+
+    // first allocation of the slot, so the dynamic offset recorded into prerecorded particle
+    // command buffers stays valid from frame to frame
+    VkDeviceSize constant_offset;
+    s_constant_ptr = Upload_Alloc(k_Constant_Size, s_gpu_properties.limits.minStorageBufferOffsetAlignment, &constant_offset);
+    if (!s_constant_ptr) LOG_AND_RETURN0();
+    s_constant_offset = (uint32_t)constant_offset;
+
+    if (s_timestamp_pending[s_res_idx]) {
+        Read_Timestamps();
+        s_timestamp_pending[s_res_idx] = 0;
+    }
+
+    Update_Palette();
+    s_frame_dset = s_common_dset[s_res_idx][s_glob_state->palette_image_idx];
+
+    // latched, the workers must not see a mode change from Handle_Events mid-recording
+    s_particle_secondary = s_glob_state->secondary_cmdbufs;
+    s_particle_draw_mode = s_glob_state->draw_mode;
+    s_particle_cached = s_glob_state->cached_positions && s_particle_cache_buf;
+
+    // in prerecorded mode the chunk command buffers of this slot are resubmitted as they are.
+    // Push constants are recorded into them, so with push constants every frame is recorded again.
+    s_particle_recording_pending = !s_glob_state->prerecorded || s_push_constants || !Is_Particle_Recording_Current();
+
+    // the push constant values have to exist before the workers record them. Producing them here
+    // keeps the recording overlapped with the present, but the camera only sees the input handled
+    // up to the previous submit, one frame later than with the constant storage buffer.
+    if (s_push_constants) {
+        Uint64 trace_begin = SDL_GetPerformanceCounter();
+        Update_Camera();
+        if (!Update_Constant_Memory()) LOG_AND_RETURN0();
+        Trace_End(0, "Update_Constant_Memory", trace_begin);
+    }
+
+#ifdef MT_UPDATE
+    if (s_particle_recording_pending) {
+        if (!Jobs_Submit(Particle_Job, NULL, s_chunk_count)) LOG_AND_RETURN0();
+    }
+#endif
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+static int Finish_Particle_Recording(void)
+{
+    if (!s_particle_recording_pending) return 1;
+    s_particle_recording_pending = 0;
+
+#ifdef MT_UPDATE
+    Jobs_Wait();
+#else
+    Uint64 begin = SDL_GetPerformanceCounter();
+    Uint64 chunk_begin = begin;
+    for (int i = 0; i < s_chunk_count; ++i) {
+        s_chunk[i].result = Update_Particle_Chunk(&s_chunk[i]);
+        chunk_begin = Trace_End(0, "Update_Particle_Chunk", chunk_begin);
+    }
+    Benchmark_End_Thread(0, begin);
+#endif
+    for (int i = 0; i < s_chunk_count; ++i) {
+        if (!s_chunk[i].result) LOG_AND_RETURN0();
+    }
+    Store_Particle_Recording();
 
     return 1;
 }
@@ -576,6 +1075,22 @@ static void Update_Camera(void)
     vmathV3Normalize(&s_camera_right, &s_camera_right);
 }
 //=============================================================================
+// Advances the palette blend. Runs in Begin_Frame, before the frame's descriptor set is picked,
+// so the palette images and palette_factor of one frame always match.
+static void Update_Palette(void)
+{
+    if (s_glob_state->transform_animate) {
+        s_glob_state->palette_factor += s_time_delta * 0.25f;
+        if (s_glob_state->palette_factor > 1.0f) {
+            for (int i = 0; i < 9; ++i) {
+                RND_GEN(s_glob_state->seed);
+            }
+            s_glob_state->palette_factor = 0.0f;
+            s_glob_state->palette_image_idx = (s_glob_state->palette_image_idx + 1) % k_Palette_Count;
+        }
+    }
+}
+//=============================================================================
 static int Update_Constant_Memory(void)
 {
     typedef struct CONSTANT
@@ -584,8 +1099,7 @@ static int Update_Constant_Memory(void)
         unsigned int data[48];
         float palette_factor;
     } CONSTANT;
-    CONSTANT *ptr;
-    VKU_VR(vkMapMemory(s_gpu_device, s_constant_mem[s_res_idx], 0, sizeof(CONSTANT), 0, (void **)&ptr));
+    CONSTANT *ptr = s_constant_ptr;
 
     VmathMatrix4 rot, view, proj;
     VmathVector3 up, atv;
@@ -603,16 +1117,6 @@ static int Update_Constant_Memory(void)
     vmathM4Mul(&ptr->viewproj, &proj, &m);
 
     float tt = s_glob_state->transform_time * s_glob_state->transform_time * (3.0f - 2.0f * s_glob_state->transform_time);
-    if (s_glob_state->transform_animate) {
-        s_glob_state->palette_factor += s_time_delta * 0.25f;
-        if (s_glob_state->palette_factor > 1.0f) {
-            for (int i = 0; i < 9; ++i) {
-                RND_GEN(s_glob_state->seed);
-            }
-            s_glob_state->palette_factor = 0.0f;
-            s_glob_state->palette_image_idx = (s_glob_state->palette_image_idx + 1) % 5;
-        }
-    }
     ptr->palette_factor = s_glob_state->palette_factor * s_glob_state->palette_factor * (3.0f - 2.0f * s_glob_state->palette_factor);
 
     if (s_glob_state->transform_animate) {
@@ -624,7 +1128,12 @@ static int Update_Constant_Memory(void)
     }
 
     ptr->data[0] = s_glob_state->seed;
-    vkUnmapMemory(s_gpu_device, s_constant_mem[s_res_idx]);
+    ptr->data[3] = s_glob_state->point_count;
+
+    // the compute passes and VS_Particle_Cached keep reading the storage buffer
+    s_push_constant.viewproj = ptr->viewproj;
+    s_push_constant.seed = ptr->data[0];
+    s_push_constant.palette_factor = ptr->palette_factor;
 
     return 1;
 }
@@ -658,6 +1167,12 @@ static int Create_Depth_Stencil(void)
 //=============================================================================
 static int Create_Common_Dset(void)
 {
+    VkDescriptorSetLayoutBinding desc8_info = {
+       8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_ALL, NULL
+    };
+    VkDescriptorSetLayoutBinding desc7_info = {
+       7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_ALL, NULL
+    };
     VkDescriptorSetLayoutBinding desc6_info = {
        6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_ALL, NULL
     };
@@ -677,9 +1192,9 @@ static int Create_Common_Dset(void)
        1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_ALL, NULL
     };
     VkDescriptorSetLayoutBinding desc0_info = {
-       0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_ALL, NULL
+       0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_ALL, NULL
     };
-    VkDescriptorSetLayoutBinding infos[7];
+    VkDescriptorSetLayoutBinding infos[9];
     infos[0] = desc0_info;
     infos[1] = desc1_info;
     infos[2] = desc2_info;
@@ -687,6 +1202,8 @@ static int Create_Common_Dset(void)
     infos[4] = desc4_info;
     infos[5] = desc5_info;
     infos[6] = desc6_info;
+    infos[7] = desc7_info;
+    infos[8] = desc8_info;
 
     VkDescriptorSetLayoutCreateInfo set_info = {
         VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, NULL, 0,
@@ -704,15 +1221,27 @@ static int Create_Common_Dset(void)
     pipeline_layout_info.pushConstantRangeCount = 0;
     pipeline_layout_info.pPushConstantRanges = NULL;
 
+    // every pipeline shares the layout, shaders that don't declare the block ignore the range
+    VkPushConstantRange push_range = {
+        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PUSH_CONSTANT)
+    };
+    if (s_push_constants) {
+        pipeline_layout_info.pushConstantRangeCount = 1;
+        pipeline_layout_info.pPushConstantRanges = &push_range;
+    }
+
     VKU_VR(vkCreatePipelineLayout(s_gpu_device, &pipeline_layout_info, NO_ALLOC_CALLBACK, &s_common_pipeline_layout));
 
+    // one set per resource slot and palette pair
+    const uint32_t set_count = k_Resource_Buffering * k_Palette_Count;
     VkDescriptorPoolSize desc_type_count[] = {
-        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * k_Resource_Buffering },
-        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5 * k_Resource_Buffering }
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * set_count },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1 * set_count },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5 * set_count }
     };
     VkDescriptorPoolCreateInfo pool_info = {
         VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, NULL, 0,
-        k_Resource_Buffering, SDL_arraysize(desc_type_count), desc_type_count
+        set_count, SDL_arraysize(desc_type_count), desc_type_count
     };
     VKU_VR(vkCreateDescriptorPool(s_gpu_device, &pool_info, NO_ALLOC_CALLBACK, &s_common_dpool));
 
@@ -722,21 +1251,24 @@ static int Create_Common_Dset(void)
     };
 
     for (int i = 0; i < k_Resource_Buffering; i++)
-        VKU_VR(vkAllocateDescriptorSets(s_gpu_device, &desc_set_alloc_info, &s_common_dset[i]));
+        for (int j = 0; j < k_Palette_Count; j++)
+            VKU_VR(vkAllocateDescriptorSets(s_gpu_device, &desc_set_alloc_info, &s_common_dset[i][j]));
 
     return 1;
 }
 //=============================================================================
-static void Update_Common_Dset(void)
+// Every resource the set points to lives as long as the demo, so each set is written once at
+// init and never touched again; frames only pick the set of their slot and palette pair.
+static void Write_Common_Dset(VkDescriptorSet dset, int palette_idx)
 {
     VkDescriptorImageInfo font_image_sampler_info = {
         s_sampler_nearest, s_font_image_view, VK_IMAGE_LAYOUT_GENERAL
     };
     VkDescriptorImageInfo palette1_image_sampler_info = {
-        s_sampler_repeat, s_palette_image_view[(s_glob_state->palette_image_idx + 1) % 5], VK_IMAGE_LAYOUT_GENERAL
+        s_sampler_repeat, s_palette_image_view[(palette_idx + 1) % k_Palette_Count], VK_IMAGE_LAYOUT_GENERAL
     };
     VkDescriptorImageInfo palette0_image_sampler_info = {
-        s_sampler_repeat, s_palette_image_view[s_glob_state->palette_image_idx], VK_IMAGE_LAYOUT_GENERAL
+        s_sampler_repeat, s_palette_image_view[palette_idx], VK_IMAGE_LAYOUT_GENERAL
     };
     VkDescriptorImageInfo skybox_image_sampler_info = {
         s_sampler, s_skybox_image_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
@@ -746,50 +1278,70 @@ static void Update_Common_Dset(void)
     };
 
     VkDescriptorBufferInfo constant_buf_info = {
-        s_constant_buf[s_res_idx], 0, 4 * sizeof(VmathMatrix4) + sizeof(float)
+        s_upload_buf, 0, k_Constant_Size
     };
 
     VkDescriptorBufferInfo skybox_buf_info = {
         s_skybox_buf, 0, 14 * sizeof(VmathVector4)
     };
 
+    VkDescriptorBufferInfo seed_buf_info = {
+        s_particle_seed_buf, 0, VK_WHOLE_SIZE
+    };
+
+    VkDescriptorBufferInfo cache_buf_info = {
+        s_particle_cache_buf, 0, VK_WHOLE_SIZE
+    };
+
+    VkWriteDescriptorSet update_cache_buffers = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, dset,
+        8, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_NULL_HANDLE,
+        &cache_buf_info, VK_NULL_HANDLE
+    };
+    VkWriteDescriptorSet update_seed_buffers = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, dset,
+        7, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_NULL_HANDLE,
+        &seed_buf_info, VK_NULL_HANDLE
+    };
+
     VkWriteDescriptorSet update_skybox_buffers = {
-        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, s_common_dset[s_res_idx],
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, dset,
         6, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_NULL_HANDLE,
         &skybox_buf_info, VK_NULL_HANDLE
     };
     VkWriteDescriptorSet update_sampler_font_image = {
-        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, s_common_dset[s_res_idx],
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, dset,
         5, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &font_image_sampler_info,
         VK_NULL_HANDLE, VK_NULL_HANDLE
     };
     VkWriteDescriptorSet update_sampler_palette1_image = {
-        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, s_common_dset[s_res_idx],
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, dset,
         4, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &palette1_image_sampler_info,
         VK_NULL_HANDLE, VK_NULL_HANDLE
     };
     VkWriteDescriptorSet update_sampler_palette0_image = {
-        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, s_common_dset[s_res_idx],
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, dset,
         3, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &palette0_image_sampler_info,
         VK_NULL_HANDLE, VK_NULL_HANDLE
     };
     VkWriteDescriptorSet update_sampler_skybox_image = {
-        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, s_common_dset[s_res_idx],
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, dset,
         2, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &skybox_image_sampler_info,
         VK_NULL_HANDLE, VK_NULL_HANDLE
     };
     VkWriteDescriptorSet update_sampler_float_image = {
-        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, s_common_dset[s_res_idx],
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, dset,
         1, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &float_image_sampler_info,
         VK_NULL_HANDLE, VK_NULL_HANDLE
     };
     VkWriteDescriptorSet update_buffers = {
-        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, s_common_dset[s_res_idx],
-        0, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_NULL_HANDLE,
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, NULL, dset,
+        0, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_NULL_HANDLE,
         &constant_buf_info, VK_NULL_HANDLE
     };
 
-    VkWriteDescriptorSet write_descriptors[7];
+    VkWriteDescriptorSet write_descriptors[9];
+    uint32_t write_count = 8;
     write_descriptors[0] = update_buffers;
     write_descriptors[1] = update_sampler_float_image;
     write_descriptors[2] = update_sampler_skybox_image;
@@ -797,70 +1349,316 @@ static void Update_Common_Dset(void)
     write_descriptors[4] = update_sampler_palette1_image;
     write_descriptors[5] = update_sampler_font_image;
     write_descriptors[6] = update_skybox_buffers;
+    write_descriptors[7] = update_seed_buffers;
+    // only the shaders of the cached path use it, it stays unwritten without them
+    if (s_particle_cache_buf) write_descriptors[write_count++] = update_cache_buffers;
 
-    vkUpdateDescriptorSets(s_gpu_device, SDL_arraysize(write_descriptors), write_descriptors, 0, NULL);
+    vkUpdateDescriptorSets(s_gpu_device, write_count, write_descriptors, 0, NULL);
 }
 //=============================================================================
-static int Create_Constant_Memory(void)
+// Host visible, coherent source buffer for a one-time upload with Copy_Buffer_And_Wait.
+static int Create_Staging_Buffer(VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory)
 {
     VkBufferCreateInfo buffer_info = {
-        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, NULL, 0, 4 * sizeof(VmathMatrix4) + sizeof(float),
-        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, 0, NULL
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, NULL, 0, size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_SHARING_MODE_EXCLUSIVE, 0, NULL
     };
+    VKU_VR(vkCreateBuffer(s_gpu_device, &buffer_info, NO_ALLOC_CALLBACK, buffer));
+
+    VkMemoryRequirements mem_reqs;
+    vkGetBufferMemoryRequirements(s_gpu_device, *buffer, &mem_reqs);
+
     VkMemoryAllocateInfo alloc_info = {
-        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, 0,
-        Get_Mem_Type_Index(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, mem_reqs.size, 0
     };
+    if (!Find_Mem_Type_Index(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             &alloc_info.memoryTypeIndex)) LOG_AND_RETURN0();
+    VKU_VR(vkAllocateMemory(s_gpu_device, &alloc_info, NO_ALLOC_CALLBACK, memory));
+    VKU_VR(vkBindBufferMemory(s_gpu_device, *buffer, *memory, 0));
 
-    for (int i = 0; i < k_Resource_Buffering; ++i) {
-        VKU_VR(vkCreateBuffer(s_gpu_device, &buffer_info, NO_ALLOC_CALLBACK, &s_constant_buf[i]));
-        VkMemoryRequirements mem_reqs;
-        vkGetBufferMemoryRequirements(s_gpu_device, s_constant_buf[i], &mem_reqs);
-        alloc_info.allocationSize = mem_reqs.size;
-        VKU_VR(vkAllocateMemory(s_gpu_device, &alloc_info, NO_ALLOC_CALLBACK, &s_constant_mem[i]));
-        VKU_VR(vkBindBufferMemory(s_gpu_device, s_constant_buf[i], s_constant_mem[i], 0));
+    return 1;
+}
+//-----------------------------------------------------------------------------
+// Records the copy into a transient command buffer and waits on its fence, the destination is
+// ready for dst_access at dst_stage in every later submission. src_access is 0 for a staging
+// source the host wrote, otherwise the copy waits for src_access at src_stage of earlier submissions.
+static int Copy_Buffer_And_Wait(VkBuffer src, VkBuffer dst, VkDeviceSize size, VkAccessFlags src_access, VkPipelineStageFlags src_stage,
+                                VkAccessFlags dst_access, VkPipelineStageFlags dst_stage)
+{
+    VkCommandBuffer cmdbuf;
+    VkCommandBufferAllocateInfo cmdbuf_info = {
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, NULL, s_command_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1
+    };
+    VKU_VR(vkAllocateCommandBuffers(s_gpu_device, &cmdbuf_info, &cmdbuf));
+
+    VkCommandBufferBeginInfo begin_info = {
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, NULL
+    };
+    VKU_VR(vkBeginCommandBuffer(cmdbuf, &begin_info));
+
+    VkBufferMemoryBarrier barrier;
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.pNext = NULL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.offset = 0;
+    barrier.size = size;
+
+    if (src_access) {
+        barrier.srcAccessMask = src_access;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.buffer = src;
+        vkCmdPipelineBarrier(cmdbuf, src_stage, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 1, &barrier, 0, NULL);
     }
 
+    VkBufferCopy region = { 0, 0, size };
+    vkCmdCopyBuffer(cmdbuf, src, dst, 1, &region);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = dst_access;
+    barrier.buffer = dst;
+    vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage, 0, 0, NULL, 1, &barrier, 0, NULL);
+
+    VKU_VR(vkEndCommandBuffer(cmdbuf));
+
+    VkFence fence;
+    VkFenceCreateInfo fence_info = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, NULL, 0 };
+    VKU_VR(vkCreateFence(s_gpu_device, &fence_info, NO_ALLOC_CALLBACK, &fence));
+
+    VkSubmitInfo submit_info = {
+        VK_STRUCTURE_TYPE_SUBMIT_INFO, NULL, 0, NULL, NULL, 1, &cmdbuf, 0, NULL
+    };
+    VkResult r = vkQueueSubmit(s_gpu_queue, 1, &submit_info, fence);
+    if (r == VK_SUCCESS) r = vkWaitForFences(s_gpu_device, 1, &fence, VK_TRUE, UINT64_MAX);
+
+    vkDestroyFence(s_gpu_device, fence, NO_ALLOC_CALLBACK);
+    vkFreeCommandBuffers(s_gpu_device, s_command_pool, 1, &cmdbuf);
+    if (r != VK_SUCCESS) LOG_AND_RETURN0();
+
+    return 1;
+}
+//=============================================================================
+// Every pipeline goes through these two, so they all share s_pipeline_cache and the creation
+// time reported by Demo_Init. A fast creation is a cache hit, the bundled headers
+// predate VK_EXT_pipeline_creation_feedback.
+static VkResult Create_Graphics_Pipeline(const VkGraphicsPipelineCreateInfo *info, VkPipeline *pipe)
+{
+    Uint64 begin = SDL_GetPerformanceCounter();
+    VkResult r = vkCreateGraphicsPipelines(s_gpu_device, s_pipeline_cache, 1, info, NO_ALLOC_CALLBACK, pipe);
+
+    // Run_Init_Tasks creates pipelines on several workers at once
+    SDL_AtomicLock(&s_pipeline_stats_lock);
+    s_pipeline_ticks += SDL_GetPerformanceCounter() - begin;
+    s_pipeline_count++;
+    SDL_AtomicUnlock(&s_pipeline_stats_lock);
+
+    return r;
+}
+//-----------------------------------------------------------------------------
+static VkResult Create_Compute_Pipeline(const VkComputePipelineCreateInfo *info, VkPipeline *pipe)
+{
+    Uint64 begin = SDL_GetPerformanceCounter();
+    VkResult r = vkCreateComputePipelines(s_gpu_device, s_pipeline_cache, 1, info, NO_ALLOC_CALLBACK, pipe);
+
+    // Run_Init_Tasks creates pipelines on several workers at once
+    SDL_AtomicLock(&s_pipeline_stats_lock);
+    s_pipeline_ticks += SDL_GetPerformanceCounter() - begin;
+    s_pipeline_count++;
+    SDL_AtomicUnlock(&s_pipeline_stats_lock);
+
+    return r;
+}
+//=============================================================================
+// Everything the CPU writes per frame (constants, graph and font vertices) is sub-allocated
+// from one persistently mapped, host coherent buffer. Each resource slot owns a fixed part of
+// it that is handed out linearly and rewound once the slot's fence has signaled.
+static int Create_Upload_Ring(void)
+{
+    VkBufferCreateInfo buffer_info = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, NULL, 0, k_Resource_Buffering * k_Upload_Ring_Slot_Size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, 0, NULL
+    };
+    VKU_VR(vkCreateBuffer(s_gpu_device, &buffer_info, NO_ALLOC_CALLBACK, &s_upload_buf));
+
+    VkMemoryRequirements mem_reqs;
+    vkGetBufferMemoryRequirements(s_gpu_device, s_upload_buf, &mem_reqs);
+
+    VkMemoryAllocateInfo alloc_info = {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, mem_reqs.size,
+        Get_Mem_Type_Index(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+    };
+    VKU_VR(vkAllocateMemory(s_gpu_device, &alloc_info, NO_ALLOC_CALLBACK, &s_upload_mem));
+    VKU_VR(vkBindBufferMemory(s_gpu_device, s_upload_buf, s_upload_mem, 0));
+    VKU_VR(vkMapMemory(s_gpu_device, s_upload_mem, 0, VK_WHOLE_SIZE, 0, (void **)&s_upload_ptr));
+
     return 1;
 }
+//-----------------------------------------------------------------------------
+static void Reset_Upload_Ring(void)
+{
+    s_upload_head = (VkDeviceSize)s_res_idx * k_Upload_Ring_Slot_Size;
+    s_upload_end = s_upload_head + k_Upload_Ring_Slot_Size;
+}
+//-----------------------------------------------------------------------------
+// Returns NULL when the slot is full; the range stays valid until the slot comes around again.
+static void *Upload_Alloc(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *offset)
+{
+    VkDeviceSize head = (s_upload_head + alignment - 1) / alignment * alignment;
+    if (head + size > s_upload_end) {
+        Log("Upload ring slot exhausted, increase k_Upload_Ring_Slot_Size\n");
+        return NULL;
+    }
+    s_upload_head = head + size;
+    *offset = head;
+
+    return s_upload_ptr + head;
+}
 //=============================================================================
 static int Create_Particles(void)
 {
+    const VkDeviceSize size = s_glob_state->point_count * sizeof(uint32_t);
     VkBufferCreateInfo buffer_info = {
-        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, NULL, 0, s_glob_state->point_count * sizeof(uint32_t),
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, 0, NULL
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, NULL, 0, size,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_SHARING_MODE_EXCLUSIVE, 0, NULL
     };
     VKU_VR(vkCreateBuffer(s_gpu_device, &buffer_info, NO_ALLOC_CALLBACK, &s_particle_seed_buf));
 
     VkMemoryRequirements mem_reqs;
     vkGetBufferMemoryRequirements(s_gpu_device, s_particle_seed_buf, &mem_reqs);
-    if (mem_reqs.size < s_glob_state->point_count * sizeof(uint32_t))
+    if (mem_reqs.size < size)
     {
         return 0;
     }
+
+    // the vertex fetch reads the seeds every frame, keep them in device local memory
+    uint32_t mem_type_index;
+    int in_place = Get_UMA_Mem_Type_Index(mem_reqs.memoryTypeBits, &mem_type_index);
+    if (!in_place && !Find_Mem_Type_Index(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &mem_type_index)) LOG_AND_RETURN0();
+
     VkMemoryAllocateInfo alloc_info = {
         VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL,
         mem_reqs.size,
-        Get_Mem_Type_Index(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        mem_type_index
     };
     VKU_VR(vkAllocateMemory(s_gpu_device, &alloc_info, NO_ALLOC_CALLBACK, &s_particle_seed_mem));
     VKU_VR(vkBindBufferMemory(s_gpu_device, s_particle_seed_buf, s_particle_seed_mem, 0));
 
+    VkBuffer staging_buf = VK_NULL_HANDLE;
+    VkDeviceMemory staging_mem = VK_NULL_HANDLE;
+    VkDeviceMemory upload_mem = s_particle_seed_mem;
+    if (!in_place) {
+        if (!Create_Staging_Buffer(size, &staging_buf, &staging_mem)) LOG_AND_RETURN0();
+        upload_mem = staging_mem;
+    }
+    Log("Particle seeds: %s\n", in_place ? "written in place (UMA)" : "uploaded to device local memory");
 
-    unsigned int seed = 23232323;
-    uint32_t *pseed = malloc(s_glob_state->point_count * sizeof(*pseed));
-    if (!pseed) LOG_AND_RETURN0();
+    // every job jumps ahead to its segment, the result matches a serial RND_GEN loop
+    void *ptr;
+    VKU_VR(vkMapMemory(s_gpu_device, upload_mem, 0, size, 0, &ptr));
+#ifdef MT_UPDATE
+    if (!Jobs_Submit(Particle_Seed_Job, ptr, Jobs_Worker_Count() * k_Particle_Chunks_Per_Worker)) LOG_AND_RETURN0();
+    Jobs_Wait();
+#else
+    Rnd_Fill(k_Particle_Seed, ptr, s_glob_state->point_count);
+#endif
+    vkUnmapMemory(s_gpu_device, upload_mem);
+
+    if (!in_place) {
+        int r = Copy_Buffer_And_Wait(staging_buf, s_particle_seed_buf, size, 0, 0,
+                                     VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+                                     VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        VKU_DESTROY(vkDestroyBuffer, staging_buf);
+        VKU_FREE_MEM(staging_mem);
+        if (!r) LOG_AND_RETURN0();
+    }
 
-    for (int i = 0; i < s_glob_state->point_count; ++i) {
-        RND_GEN(seed);
-        pseed[i] = seed;
+    return 1;
+}
+//-----------------------------------------------------------------------------
+static void Particle_Seed_Job(void *data, int job_index, int worker_index)
+{
+    (void)worker_index;
+    const int job_count = Jobs_Worker_Count() * k_Particle_Chunks_Per_Worker;
+    int first = (int)((int64_t)s_glob_state->point_count * job_index / job_count);
+    int last = (int)((int64_t)s_glob_state->point_count * (job_index + 1) / job_count);
+
+    uint32_t mul, add;
+    Rnd_Jump(first, &mul, &add);
+    Rnd_Fill(k_Particle_Seed * mul + add, (uint32_t *)data + first, last - first);
+}
+//=============================================================================
+// One VkDrawIndirectCommand per batch, the same draws the vkCmdDraw loop issues. The commands
+// never change, so they live in device local memory and are uploaded once through staging.
+static int Create_Particle_Indirect_Buffer(void)
+{
+    VkDeviceSize size = (VkDeviceSize)DRAW_COUNT * sizeof(VkDrawIndirectCommand);
+    VkBufferCreateInfo buffer_info = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, NULL, 0, size,
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_SHARING_MODE_EXCLUSIVE, 0, NULL
+    };
+    VKU_VR(vkCreateBuffer(s_gpu_device, &buffer_info, NO_ALLOC_CALLBACK, &s_particle_indirect_buf));
+
+    VkMemoryRequirements mem_reqs;
+    vkGetBufferMemoryRequirements(s_gpu_device, s_particle_indirect_buf, &mem_reqs);
+
+    VkMemoryAllocateInfo alloc_info = {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, mem_reqs.size, 0
+    };
+    if (!Find_Mem_Type_Index(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &alloc_info.memoryTypeIndex)) LOG_AND_RETURN0();
+    VKU_VR(vkAllocateMemory(s_gpu_device, &alloc_info, NO_ALLOC_CALLBACK, &s_particle_indirect_mem));
+    VKU_VR(vkBindBufferMemory(s_gpu_device, s_particle_indirect_buf, s_particle_indirect_mem, 0));
+
+    VkBuffer staging_buf;
+    VkDeviceMemory staging_mem;
+    if (!Create_Staging_Buffer(size, &staging_buf, &staging_mem)) LOG_AND_RETURN0();
+
+    VkDrawIndirectCommand *ptr;
+    VKU_VR(vkMapMemory(s_gpu_device, staging_mem, 0, size, 0, (void **)&ptr));
+    for (int i = 0; i < DRAW_COUNT; ++i) {
+        ptr[i].vertexCount = s_glob_state->batch_size;
+        ptr[i].instanceCount = 1;
+        ptr[i].firstVertex = i * s_glob_state->batch_size;
+        ptr[i].firstInstance = 0;
     }
+    vkUnmapMemory(s_gpu_device, staging_mem);
 
-    void *ptr;
-    VKU_VR(vkMapMemory(s_gpu_device, s_particle_seed_mem, 0, s_glob_state->point_count * sizeof(*pseed), 0, &ptr));
-    memcpy(ptr, pseed, s_glob_state->point_count * sizeof(*pseed));
-    vkUnmapMemory(s_gpu_device, s_particle_seed_mem);
-    free(pseed);
+    int r = Copy_Buffer_And_Wait(staging_buf, s_particle_indirect_buf, size, 0, 0,
+                                 VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+    VKU_DESTROY(vkDestroyBuffer, staging_buf);
+    VKU_FREE_MEM(staging_mem);
+    if (!r) LOG_AND_RETURN0();
+
+    return 1;
+}
+//=============================================================================
+// Particle position (xyz) and palette coordinate (w) written by CS_Particle_Evaluate and read by
+// VS_Particle_Cached. Only the GPU touches it. Allocated only when the run starts with cached
+// positions and both pipelines exist, otherwise F5 keeps evaluating per frame and -verify fails.
+static int Create_Particle_Cache_Buffer(void)
+{
+    if (!s_glob_state->cached_positions) return 1;
+    if (!s_particle_evaluate_pipe || !s_particle_cached_pipe) {
+        // -verify would have nothing to compare, so the run fails instead of passing silently
+        if (s_glob_state->verify) {
+            Enable_Logging(1);
+            Log("Verify: CS_Particle_Evaluate.spv and VS_Particle_Cached.spv are required\n");
+            Enable_Logging(s_glob_state->verbose);
+            return 0;
+        }
+        return 1;
+    }
+
+    VkBufferCreateInfo buffer_info = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, NULL, 0, s_glob_state->point_count * sizeof(VmathVector4),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, 0, NULL
+    };
+    // -verify reads the cache back after the run
+    if (s_glob_state->verify) buffer_info.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    VKU_VR(vkCreateBuffer(s_gpu_device, &buffer_info, NO_ALLOC_CALLBACK, &s_particle_cache_buf));
+
+    if (!VKU_Alloc_Buffer_Object(s_buffer_mempool_state, s_particle_cache_buf, NULL, Get_Mem_Type_Index(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))) LOG_AND_RETURN0();
+    Log("Particle cache: %llu bytes\n", (unsigned long long)buffer_info.size);
 
     return 1;
 }
@@ -881,12 +1679,8 @@ static int Create_Skybox_Geometry(void)
     {
         return 0;
     }
-    VkMemoryAllocateInfo alloc_info = {
-        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, mem_reqs.size,
-        Get_Mem_Type_Index(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
-    };
-    VKU_VR(vkAllocateMemory(s_gpu_device, &alloc_info, NO_ALLOC_CALLBACK, &s_skybox_mem));
-    VKU_VR(vkBindBufferMemory(s_gpu_device, s_skybox_buf, s_skybox_mem, 0));
+    // written by CS_Skybox_Generate every frame, the host never touches it
+    if (!VKU_Alloc_Buffer_Object(s_buffer_mempool_state, s_skybox_buf, NULL, Get_Mem_Type_Index(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))) LOG_AND_RETURN0();
 
     return 1;
 }
@@ -958,7 +1752,7 @@ static int Create_Skybox_Pipeline(void)
     vs = VK_NULL_HANDLE;
     fs = VK_NULL_HANDLE;
 
-    VKU_Load_Shader(s_gpu_device, "Data/Shader_GLSL/VS_Skybox.spv", &vs);
+    VKU_Load_Shader(s_gpu_device, s_push_constants ? "Data/Shader_GLSL/VS_Skybox_Push.spv" : "Data/Shader_GLSL/VS_Skybox.spv", &vs);
     VKU_Load_Shader(s_gpu_device, "Data/Shader_GLSL/FS_Skybox.spv", &fs);
 
     if (vs == VK_NULL_HANDLE || fs == VK_NULL_HANDLE)
@@ -1036,7 +1830,7 @@ static int Create_Skybox_Pipeline(void)
         NULL, s_common_pipeline_layout, s_float_renderpass, 0, VK_NULL_HANDLE, 0
     };
 
-    VkResult r = vkCreateGraphicsPipelines(s_gpu_device, VK_NULL_HANDLE, 1, &pi_info, NO_ALLOC_CALLBACK, &s_skybox_pipe);
+    VkResult r = Create_Graphics_Pipeline(&pi_info, &s_skybox_pipe);
 
     VKU_DESTROY(vkDestroyShaderModule, vs);
     VKU_DESTROY(vkDestroyShaderModule, fs);
@@ -1076,21 +1870,62 @@ static int Create_Skybox_Generate_Pipeline(void)
     infoPipe.basePipelineHandle = VK_NULL_HANDLE;
     infoPipe.basePipelineIndex = 0;
 
-    VkResult r = vkCreateComputePipelines(s_gpu_device, VK_NULL_HANDLE, 1, &infoPipe, NO_ALLOC_CALLBACK, &s_skybox_generate_pipe);
+    VkResult r = Create_Compute_Pipeline(&infoPipe, &s_skybox_generate_pipe);
     VKU_DESTROY(vkDestroyShaderModule, cs);
     if (r != VK_SUCCESS) LOG_AND_RETURN0();
 
     return 1;
 }
 //=============================================================================
-static int Create_Particle_Pipeline(void)
+// Optional, without the shader *pipe stays VK_NULL_HANDLE and Begin_Frame falls back to a mode
+// that does not need it (cached positions).
+static int Create_Particle_Compute_Pipeline(const char *filename, VkPipeline *pipe)
+{
+    VkShaderModule cs;
+    cs = VK_NULL_HANDLE;
+    VKU_Load_Shader(s_gpu_device, filename, &cs);
+
+    if (cs == VK_NULL_HANDLE)
+    {
+        Log("%s not found, mode disabled\n", filename);
+        return 1;
+    }
+
+    VkPipelineShaderStageCreateInfo stage_info;
+    stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stage_info.pNext = NULL;
+    stage_info.flags = 0;
+    stage_info.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    stage_info.module = cs;
+    stage_info.pName = "main";
+    stage_info.pSpecializationInfo = NULL;
+
+    VkComputePipelineCreateInfo infoPipe;
+    infoPipe.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    infoPipe.pNext = NULL;
+    infoPipe.flags = 0;
+    infoPipe.stage = stage_info;
+    infoPipe.layout = s_common_pipeline_layout;
+    infoPipe.basePipelineHandle = VK_NULL_HANDLE;
+    infoPipe.basePipelineIndex = 0;
+
+    VkResult r = Create_Compute_Pipeline(&infoPipe, pipe);
+    VKU_DESTROY(vkDestroyShaderModule, cs);
+    if (r != VK_SUCCESS) LOG_AND_RETURN0();
+
+    return 1;
+}
+//=============================================================================
+// seed_input selects VS_Particle_Draw, which takes the seed as a vertex attribute. The cached
+// variant reads everything from storage buffers and has no vertex input.
+static int Create_Particle_Pipeline(const char *vs_filename, int seed_input, VkPipeline *pipe)
 {
     VkShaderModule vs, fs;
     vs = VK_NULL_HANDLE;
     fs = VK_NULL_HANDLE;
 
-    VKU_Load_Shader(s_gpu_device, "Data/Shader_GLSL/VS_Particle_Draw.spv", &vs);
-    VKU_Load_Shader(s_gpu_device, "Data/Shader_GLSL/FS_Particle_Draw.spv", &fs);
+    VKU_Load_Shader(s_gpu_device, vs_filename, &vs);
+    VKU_Load_Shader(s_gpu_device, s_push_constants ? "Data/Shader_GLSL/FS_Particle_Draw_Push.spv" : "Data/Shader_GLSL/FS_Particle_Draw.spv", &fs);
 
     if (vs == VK_NULL_HANDLE || fs == VK_NULL_HANDLE)
     {
@@ -1156,6 +1991,10 @@ static int Create_Particle_Pipeline(void)
         VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO, NULL, 0,
         1, &vf_binding_desc, SDL_arraysize(vf_attribute_desc), vf_attribute_desc
     };
+    if (!seed_input) {
+        vf_info.vertexBindingDescriptionCount = 0;
+        vf_info.vertexAttributeDescriptionCount = 0;
+    }
 
     VkPipelineShaderStageCreateInfo shader_stage_infos[2];
     shader_stage_infos[0] = vs_info;
@@ -1167,7 +2006,7 @@ static int Create_Particle_Pipeline(void)
         NULL, s_common_pipeline_layout, s_float_renderpass, 0, VK_NULL_HANDLE, 0
     };
 
-    VkResult r = vkCreateGraphicsPipelines(s_gpu_device, VK_NULL_HANDLE, 1, &pi_info, NO_ALLOC_CALLBACK, &s_particle_pipe);
+    VkResult r = Create_Graphics_Pipeline(&pi_info, pipe);
 
     VKU_DESTROY(vkDestroyShaderModule, vs);
     VKU_DESTROY(vkDestroyShaderModule, fs);
@@ -1192,7 +2031,8 @@ static int Create_Display_Renderpass(void)
     color_attachment_desc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     color_attachment_desc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     color_attachment_desc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    color_attachment_desc.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // PRESENT_SRC_KHR needs VK_KHR_swapchain, which a headless device does not enable
+    color_attachment_desc.finalLayout = s_headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     VkAttachmentReference color_attachment_ref = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
 
@@ -1301,7 +2141,7 @@ static int Create_Display_Pipeline(void)
         NULL, s_common_pipeline_layout, s_win_renderpass, 0, VK_NULL_HANDLE, 0
     };
 
-    VkResult r = vkCreateGraphicsPipelines(s_gpu_device, VK_NULL_HANDLE, 1, &pi_info, NO_ALLOC_CALLBACK, &s_display_pipe);
+    VkResult r = Create_Graphics_Pipeline(&pi_info, &s_display_pipe);
 
     VKU_DESTROY(vkDestroyShaderModule , vs);
     VKU_DESTROY(vkDestroyShaderModule, fs);
@@ -1474,7 +2314,7 @@ static int Create_Copy_Pipeline(void)
         &ds_info, s_common_pipeline_layout, s_copy_renderpass, 0, VK_NULL_HANDLE, 0
     };
 
-    VkResult r = vkCreateGraphicsPipelines(s_gpu_device, VK_NULL_HANDLE, 1, &pi_info, NO_ALLOC_CALLBACK, &s_copy_image_pipe);
+    VkResult r = Create_Graphics_Pipeline(&pi_info, &s_copy_image_pipe);
 
     VKU_DESTROY(vkDestroyShaderModule, vs);
     VKU_DESTROY(vkDestroyShaderModule, fs);
@@ -1584,7 +2424,7 @@ static int Create_Graph_Pipeline(VkPrimitiveTopology topology, VkPipeline *pipe)
         &ds_info, s_common_pipeline_layout, s_win_renderpass, 0, VK_NULL_HANDLE, 0
     };
 
-    VkResult r = vkCreateGraphicsPipelines(s_gpu_device, VK_NULL_HANDLE, 1, &pi_info, NO_ALLOC_CALLBACK, pipe);
+    VkResult r = Create_Graphics_Pipeline(&pi_info, pipe);
 
     VKU_DESTROY(vkDestroyShaderModule, vs);
     VKU_DESTROY(vkDestroyShaderModule, fs);
@@ -1653,6 +2493,25 @@ static int Init_Dynamic_States(void)
     return 1;
 }
 //=============================================================================
+// Headless stand-ins for the swapchain images, one per resource slot.
+static int Create_Offscreen_Images(void)
+{
+    for (int i = 0; i < k_Window_Buffering; ++i) {
+        VkImageCreateInfo image_info = {
+            VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO, NULL, 0,
+            VK_IMAGE_TYPE_2D, VK_FORMAT_R8G8B8A8_UNORM, { s_glob_state->width, s_glob_state->height, 1 }, 1, 1,
+            VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_SHARING_MODE_EXCLUSIVE, 0,
+            NULL, VK_IMAGE_LAYOUT_UNDEFINED
+        };
+        VKU_VR(vkCreateImage(s_gpu_device, &image_info, NO_ALLOC_CALLBACK, &s_win_images[i]));
+        if (!VKU_Alloc_Image_Object(s_image_mempool_target, s_win_images[i], NULL,
+                                    Get_Mem_Type_Index(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))) LOG_AND_RETURN0();
+    }
+
+    return 1;
+}
+//=============================================================================
 static int Create_Window_Framebuffer(void)
 {
     for (int i = 0; i < k_Window_Buffering; ++i) {
@@ -1717,13 +2576,51 @@ static int Create_Float_Image_And_Framebuffer(void)
     return 1;
 }
 //=============================================================================
+static int Open_Texture_Sources(void)
+{
+    for (int i = 0; i < k_Texture_Source_Count; ++i) {
+        TEXTURE_SOURCE *source = &s_texture_source[i];
+        const TEXTURE_DESC *desc = &s_texture_desc[i];
+        source->desc = desc;
+        source->format = VK_FORMAT_R8G8B8A8_UNORM;
+        source->mip_count = 1;
+
+        if (!Texture_File_Open(desc->container, &source->file)) continue;
+
+        const TEXTURE_FILE_HEADER *header = source->file.header;
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(s_gpu, header->format, &props);
+
+        if (header->width != desc->width || header->height != desc->height ||
+            header->layer_count != desc->layer_count) {
+            Log("%s is %ux%u with %u layers, expected %ux%u with %u, using PNG\n", desc->container,
+                header->width, header->height, header->layer_count, desc->width, desc->height, desc->layer_count);
+            Texture_File_Close(&source->file);
+        } else if (header->format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && header->format <= VK_FORMAT_BC7_SRGB_BLOCK &&
+                   !s_gpu_features.textureCompressionBC) {
+            // the format query alone is not enough, BC images need the device feature enabled
+            Log("%s: BC compression not supported, using PNG\n", desc->container);
+            Texture_File_Close(&source->file);
+        } else if (!(props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+            Log("%s: format %u not supported, using PNG\n", desc->container, header->format);
+            Texture_File_Close(&source->file);
+        } else {
+            source->format = header->format;
+            source->mip_count = header->mip_count;
+        }
+    }
+    Log("Textures: skybox %s, format %u, %u mips\n", s_texture_source[0].file.data ? "container" : "PNG",
+        s_texture_source[0].format, s_texture_source[0].mip_count);
+
+    return 1;
+}
+//=============================================================================
 static int Create_Skybox_Image(void)
 {
     VkImageCreateInfo image_info = {
         VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO, NULL, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT,
-        VK_IMAGE_TYPE_2D, VK_FORMAT_R8G8B8A8_UNORM, { 1024, 1024, 1 }, 1, 6, VK_SAMPLE_COUNT_1_BIT,
-        VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT  |
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SHARING_MODE_EXCLUSIVE, 0,
+        VK_IMAGE_TYPE_2D, s_texture_source[0].format, { 1024, 1024, 1 }, s_texture_source[0].mip_count, 6, VK_SAMPLE_COUNT_1_BIT,
+        VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SHARING_MODE_EXCLUSIVE, 0,
         NULL, VK_IMAGE_LAYOUT_UNDEFINED
     };
     VKU_VR(vkCreateImage(s_gpu_device, &image_info, NO_ALLOC_CALLBACK, &s_skybox_image));
@@ -1731,120 +2628,12 @@ static int Create_Skybox_Image(void)
 
     VkImageViewCreateInfo image_view_info = {
         VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO, NULL, 0,
-        s_skybox_image, VK_IMAGE_VIEW_TYPE_CUBE, VK_FORMAT_R8G8B8A8_UNORM,
+        s_skybox_image, VK_IMAGE_VIEW_TYPE_CUBE, s_texture_source[0].format,
         { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A },
-        { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 6 }
+        { VK_IMAGE_ASPECT_COLOR_BIT, 0, s_texture_source[0].mip_count, 0, 6 }
     };
     VKU_VR(vkCreateImageView(s_gpu_device, &image_view_info, NO_ALLOC_CALLBACK, &s_skybox_image_view));
 
-    struct {
-        VkBuffer buffer;
-        VkDeviceMemory memory;
-    } staging_res;
-
-    VkBufferCreateInfo buffer_info = {
-        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, NULL, 0,
-        1024 * 1024 * 4 * 6,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_SHARING_MODE_EXCLUSIVE, 0, NULL
-    };
-    VKU_VR(vkCreateBuffer(s_gpu_device, &buffer_info, NO_ALLOC_CALLBACK, &staging_res.buffer));
-
-    VkMemoryRequirements mreq_buffer = { 0 };
-    vkGetBufferMemoryRequirements(s_gpu_device, staging_res.buffer, &mreq_buffer);
-
-    VkMemoryAllocateInfo alloc_info_buffer = {
-        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, mreq_buffer.size,
-        Get_Mem_Type_Index(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
-    };
-    VKU_VR(vkAllocateMemory(s_gpu_device, &alloc_info_buffer, NO_ALLOC_CALLBACK, &staging_res.memory));
-    VKU_VR(vkBindBufferMemory(s_gpu_device, staging_res.buffer, staging_res.memory, 0));
-
-    uint8_t *ptr;
-    VKU_VR(vkMapMemory(s_gpu_device, staging_res.memory, 0, VK_WHOLE_SIZE, 0, (void **)&ptr));
-
-    const char *name[6] = {
-        "Data/Texture/Skybox_right1.png", "Data/Texture/Skybox_left2.png",
-        "Data/Texture/Skybox_top3.png", "Data/Texture/Skybox_bottom4.png",
-        "Data/Texture/Skybox_front5.png", "Data/Texture/Skybox_back6.png"
-    };
-
-    VkDeviceSize offset = 0;
-    VkBufferImageCopy buffer_copy_regions[6] = { 0 };
-    for (int i = 0; i < 6; ++i) {
-        int w, h, comp;
-        stbi_uc *data = Load_Image(name[i], &w, &h, &comp, 4);
-        if (!data) LOG_AND_RETURN0();
-
-        size_t size = w * h * comp;
-        memcpy(ptr + offset, data, size);
-
-        buffer_copy_regions[i].bufferOffset = offset;
-        buffer_copy_regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        buffer_copy_regions[i].imageSubresource.baseArrayLayer = i;
-        buffer_copy_regions[i].imageSubresource.layerCount = 1;
-        buffer_copy_regions[i].imageExtent.width = w;
-        buffer_copy_regions[i].imageExtent.height = h;
-        buffer_copy_regions[i].imageExtent.depth = 1;
-
-        offset += size;
-        stbi_image_free(data);
-    }
-    vkUnmapMemory(s_gpu_device, staging_res.memory);
-
-    VkSubmitInfo submit_info;
-    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.pNext = NULL;
-    submit_info.waitSemaphoreCount = 0;
-    submit_info.pWaitSemaphores = NULL;
-    submit_info.pWaitDstStageMask = NULL;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = s_cmdbuf_display;
-    submit_info.signalSemaphoreCount = 0;
-    submit_info.pSignalSemaphores = NULL;
-
-
-    VkCommandBufferBeginInfo begin_info = {
-        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL, 0, NULL
-    };
-
-    VKU_VR(vkBeginCommandBuffer(s_cmdbuf_display[0], &begin_info));
-
-    VkImageSubresourceRange skybox_subresource_range;
-    skybox_subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    skybox_subresource_range.baseMipLevel = 0;
-    skybox_subresource_range.levelCount = 1;
-    skybox_subresource_range.baseArrayLayer = 0;
-    skybox_subresource_range.layerCount = 6;
-
-    VkImageMemoryBarrier skybox_image_barrier;
-    skybox_image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    skybox_image_barrier.pNext = NULL;
-    skybox_image_barrier.srcAccessMask = 0;
-    skybox_image_barrier.dstAccessMask = 0;
-    skybox_image_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    skybox_image_barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-    skybox_image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    skybox_image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    skybox_image_barrier.image = s_skybox_image;
-    skybox_image_barrier.subresourceRange = skybox_subresource_range;
-    vkCmdPipelineBarrier(s_cmdbuf_display[0], VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &skybox_image_barrier);
-
-    vkCmdCopyBufferToImage(s_cmdbuf_display[0], staging_res.buffer, s_skybox_image, VK_IMAGE_LAYOUT_GENERAL, 6, buffer_copy_regions);
-
-    skybox_image_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    skybox_image_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-    skybox_image_barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-    skybox_image_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    vkCmdPipelineBarrier(s_cmdbuf_display[0], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &skybox_image_barrier);
-
-    VKU_VR(vkEndCommandBuffer(s_cmdbuf_display[0]));
-
-    if (vkQueueSubmit(s_gpu_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
-        LOG_AND_RETURN0();
-    }
-    if (vkQueueWaitIdle(s_gpu_queue) != VK_SUCCESS) {
-        LOG_AND_RETURN0();
-    }
     return 1;
 }
 //=============================================================================
@@ -1853,186 +2642,269 @@ static int Create_Palette_Images(void)
     for (int i = 0; i < 6; ++i) {
         VkImageCreateInfo image_info = {
             VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO, NULL, 0,
-            VK_IMAGE_TYPE_2D, VK_FORMAT_R8G8B8A8_UNORM, { 256, 1, 1 }, 1, 1, VK_SAMPLE_COUNT_1_BIT,
-            VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT |
-            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SHARING_MODE_EXCLUSIVE, 0,
-            NULL, VK_IMAGE_LAYOUT_UNDEFINED
+            VK_IMAGE_TYPE_2D, s_texture_source[1 + i].format, { 256, 1, 1 }, s_texture_source[1 + i].mip_count, 1,
+            VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            VK_SHARING_MODE_EXCLUSIVE, 0, NULL, VK_IMAGE_LAYOUT_UNDEFINED
         };
         VKU_VR(vkCreateImage(s_gpu_device, &image_info, NO_ALLOC_CALLBACK, &s_palette_image[i]));
         if (!VKU_Alloc_Image_Object(s_image_mempool_texture, s_palette_image[i], NULL, Get_Mem_Type_Index(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))) return 0;
 
         VkImageViewCreateInfo image_view_info = {
             VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO, NULL, 0,
-            s_palette_image[i], VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_R8G8B8A8_UNORM,
+            s_palette_image[i], VK_IMAGE_VIEW_TYPE_2D, s_texture_source[1 + i].format,
             {
                 VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B,
                 VK_COMPONENT_SWIZZLE_A
             },
-            { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+            { VK_IMAGE_ASPECT_COLOR_BIT, 0, s_texture_source[1 + i].mip_count, 0, 1 }
         };
         VKU_VR(vkCreateImageView(s_gpu_device, &image_view_info, NO_ALLOC_CALLBACK, &s_palette_image_view[i]));
     }
 
-    struct {
-        VkBuffer buffer;
-        VkDeviceMemory memory;
-    } staging_res;
-
-    VkBufferCreateInfo buffer_info = {
-        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, NULL, 0,
-        256 * 4 * 6,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_SHARING_MODE_EXCLUSIVE, 0, NULL
-    };
-    VKU_VR(vkCreateBuffer(s_gpu_device, &buffer_info, NO_ALLOC_CALLBACK, &staging_res.buffer));
-
-    VkMemoryRequirements mreq_buffer = { 0 };
-    vkGetBufferMemoryRequirements(s_gpu_device, staging_res.buffer, &mreq_buffer);
-
-    VkMemoryAllocateInfo alloc_info_buffer = {
-        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, mreq_buffer.size,
-        Get_Mem_Type_Index(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
-    };
-    VKU_VR(vkAllocateMemory(s_gpu_device, &alloc_info_buffer, NO_ALLOC_CALLBACK, &staging_res.memory));
-    VKU_VR(vkBindBufferMemory(s_gpu_device, staging_res.buffer, staging_res.memory, 0));
+    return 1;
+}
+//-----------------------------------------------------------------------------
+// One layer of a texture source, its mips are packed in the staging buffer like container levels.
+typedef struct TEXTURE_UPLOAD
+{
+    const TEXTURE_SOURCE                *source;
+    VkImage                             image;
+    uint32_t                            layer;
+    VkDeviceSize                        offset;
+    uint8_t                             *dst;
+    int                                 result;
+} TEXTURE_UPLOAD;
+//-----------------------------------------------------------------------------
+static VkDeviceSize Texture_Mip_Size(const TEXTURE_SOURCE *source, uint32_t mip)
+{
+    return Texture_File_Level_Size(source->format, SDL_max(source->desc->width >> mip, 1u), SDL_max(source->desc->height >> mip, 1u));
+}
+//-----------------------------------------------------------------------------
+static void Decode_Texture_Job(void *data, int job_index, int worker_index)
+{
+    (void)worker_index;
+    TEXTURE_UPLOAD *upload = (TEXTURE_UPLOAD *)data + job_index;
+    const TEXTURE_SOURCE *source = upload->source;
+
+    // a container level is already in the image format, copy it out of the mapping
+    if (source->file.data) {
+        uint8_t *dst = upload->dst;
+        for (uint32_t mip = 0; mip < source->mip_count; ++mip) {
+            const TEXTURE_FILE_LEVEL *level = &source->file.level[upload->layer * source->mip_count + mip];
+            memcpy(dst, (const uint8_t *)source->file.data + level->offset, (size_t)level->size);
+            dst += VKU_ALIGN(level->size, k_Texture_File_Alignment);
+        }
+        upload->result = 1;
+        return;
+    }
+
+    const char *filename = source->desc->png[upload->layer];
+    int w, h, comp;
+    stbi_uc *pixels = Load_Image(filename, &w, &h, &comp, 4);
+    if (!pixels) {
+        Log("%s not found\n", filename);
+        return;
+    }
+    if (w == (int)source->desc->width && h == (int)source->desc->height) {
+        memcpy(upload->dst, pixels, source->desc->width * source->desc->height * 4);
+        upload->result = 1;
+    } else {
+        Log("%s is %dx%d, expected %ux%u\n", filename, w, h, source->desc->width, source->desc->height);
+    }
+    stbi_image_free(pixels);
+}
+//-----------------------------------------------------------------------------
+// Fills the skybox and palette images and moves them, and the font image, to their sampled
+// layouts. Container levels are copied and PNGs decoded on the job workers straight into one
+// staging buffer, every copy and transition goes into a single command buffer and the CPU waits
+// on one fence.
+static int Upload_Textures(void)
+{
+    TEXTURE_UPLOAD upload[k_Texture_Upload_Count] = { 0 };
+    int upload_count = 0;
+    VkDeviceSize size = 0;
+    for (int i = 0; i < k_Texture_Source_Count; ++i) {
+        for (uint32_t layer = 0; layer < s_texture_source[i].desc->layer_count; ++layer) {
+            if (upload_count == k_Texture_Upload_Count) LOG_AND_RETURN0();
+            upload[upload_count].source = &s_texture_source[i];
+            upload[upload_count].image = i == 0 ? s_skybox_image : s_palette_image[i - 1];
+            upload[upload_count].layer = layer;
+            upload[upload_count].offset = size;
+            for (uint32_t mip = 0; mip < s_texture_source[i].mip_count; ++mip) {
+                size += VKU_ALIGN(Texture_Mip_Size(&s_texture_source[i], mip), k_Texture_File_Alignment);
+            }
+            upload_count++;
+        }
+    }
+
+    VkBuffer staging_buf;
+    VkDeviceMemory staging_mem;
+    if (!Create_Staging_Buffer(size, &staging_buf, &staging_mem)) LOG_AND_RETURN0();
 
     uint8_t *ptr;
-    VKU_VR(vkMapMemory(s_gpu_device, staging_res.memory, 0, VK_WHOLE_SIZE, 0, (void **)&ptr));
-
-    const char *name[6] = {
-        "Data/Texture/Palette_Fire.png", "Data/Texture/Palette_Purple.png",
-        "Data/Texture/Palette_Muted.png", "Data/Texture/Palette_Rainbow.png",
-        "Data/Texture/Palette_Sky.png", "Data/Texture/Palette_Sky.png"
-    };
-
-    VkDeviceSize offset = 0;
-    VkBufferImageCopy buffer_copy_regions[6] = { 0 };
-    for (int i = 0; i < 6; ++i) {
-        int w, h, comp;
-        stbi_uc *data = Load_Image(name[i], &w, &h, &comp, 4);
-        if (!data) LOG_AND_RETURN0();
-
-        size_t size = w * h * comp;
-        memcpy(ptr + offset, data, size);
+    VKU_VR(vkMapMemory(s_gpu_device, staging_mem, 0, size, 0, (void **)&ptr));
+    for (int i = 0; i < upload_count; ++i) upload[i].dst = ptr + upload[i].offset;
 
-        buffer_copy_regions[i].bufferOffset = offset;
-        buffer_copy_regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        buffer_copy_regions[i].imageSubresource.baseArrayLayer = 0;
-        buffer_copy_regions[i].imageSubresource.layerCount = 1;
-        buffer_copy_regions[i].imageExtent.width = w;
-        buffer_copy_regions[i].imageExtent.height = h;
-        buffer_copy_regions[i].imageExtent.depth = 1;
-
-        offset += size;
-        stbi_image_free(data);
-    }
-    vkUnmapMemory(s_gpu_device, staging_res.memory);
+    Uint64 decode_begin = SDL_GetPerformanceCounter();
+#ifdef MT_UPDATE
+    if (!Jobs_Submit(Decode_Texture_Job, upload, upload_count)) LOG_AND_RETURN0();
+    Jobs_Wait();
+#else
+    for (int i = 0; i < upload_count; ++i) Decode_Texture_Job(upload, i, 0);
+#endif
+    Log("Textures: %d layers, %u KB staged in %.1f ms\n", upload_count, (unsigned)(size / 1024),
+        1000.0 * (SDL_GetPerformanceCounter() - decode_begin) / SDL_GetPerformanceFrequency());
+    vkUnmapMemory(s_gpu_device, staging_mem);
+
+    int result = 1;
+    for (int i = 0; i < upload_count; ++i) result &= upload[i].result;
+    for (int i = 0; i < k_Texture_Source_Count; ++i) Texture_File_Close(&s_texture_source[i].file);
+
+    VkCommandBuffer cmdbuf = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    VkResult r = VK_SUCCESS;
+    if (result) {
+        VkCommandBufferAllocateInfo cmdbuf_info = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, NULL, s_command_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1
+        };
+        VKU_VR(vkAllocateCommandBuffers(s_gpu_device, &cmdbuf_info, &cmdbuf));
 
-    VkCommandBufferBeginInfo begin_info = {
-       VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL, 0, NULL
-    };
+        VkCommandBufferBeginInfo begin_info = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, NULL
+        };
+        VKU_VR(vkBeginCommandBuffer(cmdbuf, &begin_info));
+
+        // 0 skybox, 1..6 palettes, 7 font
+        VkImageMemoryBarrier barrier[8];
+        for (int i = 0; i < 7; ++i) {
+            barrier[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier[i].pNext = NULL;
+            barrier[i].srcAccessMask = 0;
+            barrier[i].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier[i].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier[i].image = i == 0 ? s_skybox_image : s_palette_image[i - 1];
+            barrier[i].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier[i].subresourceRange.baseMipLevel = 0;
+            barrier[i].subresourceRange.levelCount = s_texture_source[i].mip_count;
+            barrier[i].subresourceRange.baseArrayLayer = 0;
+            barrier[i].subresourceRange.layerCount = i == 0 ? 6 : 1;
+        }
+        vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 7, barrier);
+
+        for (int i = 0; i < upload_count; ++i) {
+            const TEXTURE_SOURCE *source = upload[i].source;
+            VkBufferImageCopy region[k_Texture_File_Max_Mips] = { 0 };
+            VkDeviceSize offset = upload[i].offset;
+            for (uint32_t mip = 0; mip < source->mip_count; ++mip) {
+                region[mip].bufferOffset = offset;
+                region[mip].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                region[mip].imageSubresource.mipLevel = mip;
+                region[mip].imageSubresource.baseArrayLayer = upload[i].layer;
+                region[mip].imageSubresource.layerCount = 1;
+                region[mip].imageExtent.width = SDL_max(source->desc->width >> mip, 1u);
+                region[mip].imageExtent.height = SDL_max(source->desc->height >> mip, 1u);
+                region[mip].imageExtent.depth = 1;
+                offset += VKU_ALIGN(Texture_Mip_Size(source, mip), k_Texture_File_Alignment);
+            }
+            vkCmdCopyBufferToImage(cmdbuf, staging_buf, upload[i].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   source->mip_count, region);
+        }
 
-    VKU_VR(vkBeginCommandBuffer(s_cmdbuf_display[0], &begin_info));
+        // the layouts Write_Common_Dset expects
+        for (int i = 0; i < 7; ++i) {
+            barrier[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier[i].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier[i].newLayout = i == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+        }
+        barrier[7] = barrier[1];
+        barrier[7].subresourceRange.levelCount = 1;
+        barrier[7].srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
+        barrier[7].oldLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+        barrier[7].image = s_font_image;
+        vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 0, NULL, 0, NULL, SDL_arraysize(barrier), barrier);
 
-    VkImageSubresourceRange palette_subresource_range[6];
-    VkImageMemoryBarrier palette_image_memory_barrier[6];
+        VKU_VR(vkEndCommandBuffer(cmdbuf));
 
-    for (int i = 0; i < 6; ++i) {
-        palette_subresource_range[i].aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        palette_subresource_range[i].baseMipLevel = 0;
-        palette_subresource_range[i].levelCount = 1;
-        palette_subresource_range[i].baseArrayLayer = 0;
-        palette_subresource_range[i].layerCount = 1;
-
-        palette_image_memory_barrier[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        palette_image_memory_barrier[i].pNext = NULL;
-        palette_image_memory_barrier[i].srcAccessMask = 0;
-        palette_image_memory_barrier[i].dstAccessMask = 0;
-        palette_image_memory_barrier[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        palette_image_memory_barrier[i].newLayout = VK_IMAGE_LAYOUT_GENERAL;
-        palette_image_memory_barrier[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        palette_image_memory_barrier[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        palette_image_memory_barrier[i].image = s_palette_image[i];
-        palette_image_memory_barrier[i].subresourceRange = palette_subresource_range[i];
-    }
-
-    vkCmdPipelineBarrier(s_cmdbuf_display[0], VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, 0, NULL, 0, NULL,
-        SDL_arraysize(palette_image_memory_barrier), palette_image_memory_barrier);
+        VkFenceCreateInfo fence_info = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, NULL, 0 };
+        VKU_VR(vkCreateFence(s_gpu_device, &fence_info, NO_ALLOC_CALLBACK, &fence));
 
-    for (int i = 0; i < 6; ++i) {
-        vkCmdCopyBufferToImage(s_cmdbuf_display[0], staging_res.buffer, s_palette_image[i], VK_IMAGE_LAYOUT_GENERAL, 1, &buffer_copy_regions[i]);
+        VkSubmitInfo submit_info = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO, NULL, 0, NULL, NULL, 1, &cmdbuf, 0, NULL
+        };
+        r = vkQueueSubmit(s_gpu_queue, 1, &submit_info, fence);
+        if (r == VK_SUCCESS) r = vkWaitForFences(s_gpu_device, 1, &fence, VK_TRUE, UINT64_MAX);
     }
-    VKU_VR(vkEndCommandBuffer(s_cmdbuf_display[0]));
 
-    VkSubmitInfo submit_info;
-    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.pNext = NULL;
-    submit_info.waitSemaphoreCount = 0;
-    submit_info.pWaitSemaphores = NULL;
-    submit_info.pWaitDstStageMask = NULL;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = s_cmdbuf_display;
-    submit_info.signalSemaphoreCount = 0;
-    submit_info.pSignalSemaphores = NULL;
-
-    if (vkQueueSubmit(s_gpu_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
-        LOG_AND_RETURN0();
-    }
-    if (vkQueueWaitIdle(s_gpu_queue) != VK_SUCCESS) {
-        LOG_AND_RETURN0();
-    }
+    VKU_DESTROY(vkDestroyFence, fence);
+    if (cmdbuf) vkFreeCommandBuffers(s_gpu_device, s_command_pool, 1, &cmdbuf);
+    VKU_DESTROY(vkDestroyBuffer, staging_buf);
+    VKU_FREE_MEM(staging_mem);
+    if (!result || r != VK_SUCCESS) LOG_AND_RETURN0();
 
     return 1;
 }
 //=============================================================================
-static int Init_Particle_Thread(THREAD_DATA *thrd)
+static int Init_Particle_Chunk(PARTICLE_CHUNK *chunk)
 {
     VkCommandPoolCreateInfo command_pool_info;
     command_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     command_pool_info.pNext = NULL;
     command_pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
     command_pool_info.queueFamilyIndex = s_queue_family_index;
-    VKU_VR(vkCreateCommandPool(s_gpu_device, &command_pool_info, NO_ALLOC_CALLBACK, &thrd->cmdpool));
+    VKU_VR(vkCreateCommandPool(s_gpu_device, &command_pool_info, NO_ALLOC_CALLBACK, &chunk->cmdpool));
 
     VkCommandBufferAllocateInfo cmdbuf_info = {
-        VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, NULL, thrd->cmdpool,
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, NULL, chunk->cmdpool,
         VK_COMMAND_BUFFER_LEVEL_PRIMARY, k_Resource_Buffering
     };
-    VKU_VR(vkAllocateCommandBuffers(s_gpu_device, &cmdbuf_info, thrd->cmdbuf));
+    VKU_VR(vkAllocateCommandBuffers(s_gpu_device, &cmdbuf_info, chunk->cmdbuf));
 
-    thrd->sem = SDL_CreateSemaphore(0);
-    if (!thrd->sem) LOG_AND_RETURN0();
+    cmdbuf_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    VKU_VR(vkAllocateCommandBuffers(s_gpu_device, &cmdbuf_info, chunk->cmdbuf_secondary));
 
     return 1;
 }
 //=============================================================================
-static int Finish_Particle_Thread(THREAD_DATA *thrd)
+static int Release_Particle_Chunk(PARTICLE_CHUNK *chunk)
 {
-    if (s_exit_code == STARDUST_ERROR) {
-        SDL_SemPost(s_cmdgen_sem[thrd->tid]);
-    }
-    SDL_WaitThread(thrd->thread, NULL);
+    VKU_FREE_CMD_BUF(chunk->cmdpool, k_Resource_Buffering, chunk->cmdbuf);
+    VKU_FREE_CMD_BUF(chunk->cmdpool, k_Resource_Buffering, chunk->cmdbuf_secondary);
+    VKU_DESTROY(vkDestroyCommandPool, chunk->cmdpool);
 
     return 1;
 }
 //=============================================================================
-static int Release_Particle_Thread(THREAD_DATA *thrd)
+static int Update_Particle_Chunk(PARTICLE_CHUNK *chunk)
 {
-    SDL_DestroySemaphore(thrd->sem);
-    thrd->sem = NULL;
+    if (s_particle_secondary) {
+        // the render pass is begun once by the main thread, see Cmd_Execute_Particle_Chunks
+        VkCommandBufferInheritanceInfo inheritance_info = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO, NULL, s_float_renderpass, 0, s_float_framebuffer,
+            VK_FALSE, 0, 0
+        };
+        VkCommandBufferBeginInfo begin_info = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+            VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, &inheritance_info
+        };
 
-    VKU_FREE_CMD_BUF(thrd->cmdpool, k_Resource_Buffering, thrd->cmdbuf);
-    VKU_DESTROY(vkDestroyCommandPool, thrd->cmdpool);
+        VKU_VR(vkBeginCommandBuffer(chunk->cmdbuf_secondary[s_res_idx], &begin_info));
+        Cmd_Draw_Particles(chunk->cmdbuf_secondary[s_res_idx], chunk);
+        VKU_VR(vkEndCommandBuffer(chunk->cmdbuf_secondary[s_res_idx]));
+
+        return 1;
+    }
 
-    return 1;
-}
-//=============================================================================
-static int Update_Particle_Thread(THREAD_DATA *thrd)
-{
     VkCommandBufferBeginInfo begin_info = {
         VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL, 0, NULL
     };
 
-    VKU_VR(vkBeginCommandBuffer(thrd->cmdbuf[s_res_idx], &begin_info));
+    VKU_VR(vkBeginCommandBuffer(chunk->cmdbuf[s_res_idx], &begin_info));
 
     VkRect2D render_area = { { 0, 0 }, { s_glob_state->width, s_glob_state->height } };
     VkClearValue clear_color = { 0 };
@@ -2044,41 +2916,192 @@ static int Update_Particle_Thread(THREAD_DATA *thrd)
     rpBegin.renderArea = render_area;
     rpBegin.clearValueCount = 2;
     rpBegin.pClearValues = &clear_color;
-    vkCmdBeginRenderPass(thrd->cmdbuf[s_res_idx], &rpBegin, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(chunk->cmdbuf[s_res_idx], &rpBegin, VK_SUBPASS_CONTENTS_INLINE);
+
+    Cmd_Draw_Particles(chunk->cmdbuf[s_res_idx], chunk);
 
-    vkCmdBindPipeline(thrd->cmdbuf[s_res_idx], VK_PIPELINE_BIND_POINT_GRAPHICS, s_particle_pipe);
-    vkCmdBindDescriptorSets(thrd->cmdbuf[s_res_idx], VK_PIPELINE_BIND_POINT_GRAPHICS, s_common_pipeline_layout,
-                            0, 1, &s_common_dset[s_res_idx], 0, NULL);
+    vkCmdEndRenderPass(chunk->cmdbuf[s_res_idx]);
+    VKU_VR(vkEndCommandBuffer(chunk->cmdbuf[s_res_idx]));
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+static int Is_Particle_Recording_Current(void)
+{
+    PARTICLE_RECORDING *rec = &s_particle_recording[s_res_idx];
+
+    return rec->valid &&
+           rec->secondary == s_particle_secondary &&
+           rec->point_count == s_glob_state->point_count &&
+           rec->batch_size == s_glob_state->batch_size &&
+           rec->chunk_count == s_chunk_count &&
+           rec->framebuffer == s_float_framebuffer &&
+           rec->palette_image_idx == s_glob_state->palette_image_idx &&
+           rec->draw_mode == s_particle_draw_mode &&
+           rec->cached == s_particle_cached &&
+           rec->constant_offset == s_constant_offset;
+}
+//-----------------------------------------------------------------------------
+static void Store_Particle_Recording(void)
+{
+    PARTICLE_RECORDING *rec = &s_particle_recording[s_res_idx];
+
+    rec->valid = 1;
+    rec->secondary = s_particle_secondary;
+    rec->point_count = s_glob_state->point_count;
+    rec->batch_size = s_glob_state->batch_size;
+    rec->chunk_count = s_chunk_count;
+    rec->framebuffer = s_float_framebuffer;
+    rec->palette_image_idx = s_glob_state->palette_image_idx;
+    rec->draw_mode = s_particle_draw_mode;
+    rec->cached = s_particle_cached;
+    rec->constant_offset = s_constant_offset;
+}
+//-----------------------------------------------------------------------------
+static void Cmd_Draw_Particles(VkCommandBuffer cmdbuf, PARTICLE_CHUNK *chunk)
+{
+    vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, s_particle_cached ? s_particle_cached_pipe : s_particle_pipe);
+    vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, s_common_pipeline_layout,
+                            0, 1, &s_frame_dset, 1, &s_constant_offset);
+    if (s_push_constants) {
+        vkCmdPushConstants(cmdbuf, s_common_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                           0, sizeof(PUSH_CONSTANT), &s_push_constant);
+    }
 
-    VkDeviceSize offsets = 0;
-    vkCmdBindVertexBuffers(thrd->cmdbuf[s_res_idx], 0, 1, &s_particle_seed_buf, &offsets);
-    for (int i = 0; i < DRAW_PER_THREAD; ++i) {
-        uint32_t firstVertex = (i + thrd->tid * DRAW_PER_THREAD) * s_glob_state->batch_size;
-        vkCmdDraw(thrd->cmdbuf[s_res_idx], s_glob_state->batch_size, 1, firstVertex, 0);
+    if (!s_particle_cached) {
+        VkDeviceSize offsets = 0;
+        vkCmdBindVertexBuffers(cmdbuf, 0, 1, &s_particle_seed_buf, &offsets);
     }
 
-    vkCmdEndRenderPass(thrd->cmdbuf[s_res_idx]);
-    VKU_VR(vkEndCommandBuffer(thrd->cmdbuf[s_res_idx]));
+    if (s_particle_draw_mode == DRAW_MODE_INDIRECT) {
+        // without multiDrawIndirect every indirect call is limited to a single draw
+        uint32_t max_count = s_gpu_features.multiDrawIndirect ? s_gpu_properties.limits.maxDrawIndirectCount : 1;
+        uint32_t stride = sizeof(VkDrawIndirectCommand);
 
-    return 1;
+        for (int i = 0; i < chunk->draw_count;) {
+            uint32_t count = SDL_min((uint32_t)(chunk->draw_count - i), max_count);
+            vkCmdDrawIndirect(cmdbuf, s_particle_indirect_buf, (VkDeviceSize)(chunk->first_draw + i) * stride, count, stride);
+            i += count;
+        }
+        return;
+    }
+
+    for (int i = 0; i < chunk->draw_count; ++i) {
+        uint32_t firstVertex = (chunk->first_draw + i) * s_glob_state->batch_size;
+        vkCmdDraw(cmdbuf, s_glob_state->batch_size, 1, firstVertex, 0);
+    }
 }
-//=============================================================================
-static int SDLCALL Particle_Thread(void *data)
+//-----------------------------------------------------------------------------
+static void Cmd_Execute_Particle_Chunks(VkCommandBuffer cmdbuf)
 {
-    THREAD_DATA *thrd = data;
+    VkCommandBuffer *secondary = s_cmdbuf_list;
+    for (int i = 0; i < s_chunk_count; ++i) {
+        secondary[i] = s_chunk[i].cmdbuf_secondary[s_res_idx];
+    }
 
-#if defined(_WIN32)
-    SetThreadAffinityMask(GetCurrentThread(), ((DWORD_PTR)1) << thrd->tid);
-#endif
+    VkRect2D render_area = { { 0, 0 }, { s_glob_state->width, s_glob_state->height } };
+    VkClearValue clear_color = { 0 };
+    VkRenderPassBeginInfo rpBegin;
+    rpBegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    rpBegin.pNext = NULL;
+    rpBegin.renderPass = s_float_renderpass;
+    rpBegin.framebuffer = s_float_framebuffer;
+    rpBegin.renderArea = render_area;
+    rpBegin.clearValueCount = 2;
+    rpBegin.pClearValues = &clear_color;
+    vkCmdBeginRenderPass(cmdbuf, &rpBegin, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+    // one render pass instance for all chunks, executed in draw order
+    vkCmdExecuteCommands(cmdbuf, s_chunk_count, secondary);
+
+    vkCmdEndRenderPass(cmdbuf);
+}
+//=============================================================================
+static void Particle_Job(void *data, int job_index, int worker_index)
+{
+    (void)data;
+    Uint64 begin = SDL_GetPerformanceCounter();
+    s_chunk[job_index].result = Update_Particle_Chunk(&s_chunk[job_index]);
+    Trace_End(worker_index, "Update_Particle_Chunk", begin);
+    Benchmark_End_Thread(worker_index, begin);
+}
+//=============================================================================
+static void Particle_Thread_Init(int worker_index)
+{
+    Topology_Pin_Thread(worker_index);
+}
+//=============================================================================
+// Without timestampValidBits on the queue family there are no GPU times, the pool stays null.
+static int Create_Timestamp_Pool(void)
+{
+    uint32_t family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(s_gpu, &family_count, NULL);
+    VkQueueFamilyProperties *families = malloc(family_count * sizeof(*families));
+    if (!families) LOG_AND_RETURN0();
+    vkGetPhysicalDeviceQueueFamilyProperties(s_gpu, &family_count, families);
+    uint32_t valid_bits = s_queue_family_index < family_count ? families[s_queue_family_index].timestampValidBits : 0;
+    free(families);
+
+    if (!valid_bits) {
+        Log("Queue family %u has no timestamp support, GPU times disabled\n", s_queue_family_index);
+        return 1;
+    }
+    s_timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
 
-    do {
-        SDL_SemWait(s_cmdgen_sem[thrd->tid]);
-        Update_Particle_Thread(thrd);
-        SDL_SemPost(thrd->sem);
-    } while (s_exit_code == STARDUST_CONTINUE);
+    VkQueryPoolCreateInfo pool_info = {
+        VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO, NULL, 0, VK_QUERY_TYPE_TIMESTAMP,
+        k_Resource_Buffering * TIMESTAMP_COUNT, 0
+    };
+    VKU_VR(vkCreateQueryPool(s_gpu_device, &pool_info, NO_ALLOC_CALLBACK, &s_timestamp_pool));
 
     return 1;
 }
+//-----------------------------------------------------------------------------
+// The begin timestamp is written at TOP_OF_PIPE, when the first command of the pass starts, the
+// end timestamp at BOTTOM_OF_PIPE, when all work recorded so far has completed. Work of the
+// previous pass can still be draining when the next one begins, so pass times overlap and add
+// up to more than GPU_PASS_FRAME. Beginning GPU_PASS_FRAME resets the queries of the slot, it
+// must come first and outside a render pass.
+static void Cmd_Begin_Gpu_Pass(VkCommandBuffer cmdbuf, int pass)
+{
+    if (!s_timestamp_pool) return;
+
+    uint32_t first = s_res_idx * TIMESTAMP_COUNT;
+    if (pass == GPU_PASS_FRAME) {
+        vkCmdResetQueryPool(cmdbuf, s_timestamp_pool, first, TIMESTAMP_COUNT);
+        s_timestamp_pending[s_res_idx] = 1;
+    }
+    vkCmdWriteTimestamp(cmdbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, s_timestamp_pool, first + 2 * pass);
+}
+//-----------------------------------------------------------------------------
+static void Cmd_End_Gpu_Pass(VkCommandBuffer cmdbuf, int pass)
+{
+    if (!s_timestamp_pool) return;
+
+    vkCmdWriteTimestamp(cmdbuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, s_timestamp_pool,
+                        s_res_idx * TIMESTAMP_COUNT + 2 * pass + 1);
+}
+//-----------------------------------------------------------------------------
+// Called once the fence of the slot has signaled, k_Resource_Buffering frames at most after the
+// timestamps were written, so the results are there without waiting.
+static void Read_Timestamps(void)
+{
+    uint64_t ts[TIMESTAMP_COUNT];
+    VkResult result = vkGetQueryPoolResults(s_gpu_device, s_timestamp_pool, s_res_idx * TIMESTAMP_COUNT, TIMESTAMP_COUNT,
+                                            sizeof(ts), ts, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) return;
+
+    const float ms_per_tick = s_gpu_properties.limits.timestampPeriod * 1e-6f;
+    for (int i = 0; i < GPU_PASS_COUNT; ++i) {
+        s_gpu_ms[i] = ((ts[2 * i + 1] - ts[2 * i]) & s_timestamp_mask) * ms_per_tick;
+    }
+
+    for (int i = 0; i < GPU_PASS_COUNT; ++i) {
+        Benchmark_Gpu_Pass(i, s_gpu_ms[i]);
+    }
+    s_gpu_graph_sum += s_gpu_ms[GPU_PASS_FRAME];
+    s_gpu_graph_count++;
+}
 //=============================================================================
 static void Cmd_Clear(VkCommandBuffer cmdbuf)
 {
@@ -2235,7 +3258,7 @@ static void Cmd_Display_Fractal(VkCommandBuffer cmdbuf)
 {
 
     vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, s_display_pipe);
-    vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, s_common_pipeline_layout, 0, 1, &s_common_dset[s_res_idx], 0, NULL);
+    vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, s_common_pipeline_layout, 0, 1, &s_frame_dset, 1, &s_constant_offset);
 
     vkCmdDraw(cmdbuf, 4, 1, 0, 0);
 }
@@ -2243,7 +3266,7 @@ static void Cmd_Display_Fractal(VkCommandBuffer cmdbuf)
 static void Cmd_Render_Skybox(VkCommandBuffer cmdbuf)
 {
     vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_COMPUTE, s_skybox_generate_pipe);
-    vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_COMPUTE, s_common_pipeline_layout, 0, 1, &s_common_dset[s_res_idx], 0, NULL);
+    vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_COMPUTE, s_common_pipeline_layout, 0, 1, &s_frame_dset, 1, &s_constant_offset);
     vkCmdDispatch(cmdbuf, 1, 1, 1);
 
     vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, 0, NULL, 0, NULL, 0, NULL);
@@ -2265,7 +3288,11 @@ static void Cmd_Render_Skybox(VkCommandBuffer cmdbuf)
     vkCmdBeginRenderPass(cmdbuf, &rpBegin, VK_SUBPASS_CONTENTS_INLINE);
 
     vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, s_skybox_pipe);
-    vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, s_common_pipeline_layout, 0, 1, &s_common_dset[s_res_idx], 0, NULL);
+    vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, s_common_pipeline_layout, 0, 1, &s_frame_dset, 1, &s_constant_offset);
+    if (s_push_constants) {
+        vkCmdPushConstants(cmdbuf, s_common_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                           0, sizeof(PUSH_CONSTANT), &s_push_constant);
+    }
 
     VkDeviceSize offset = 0;
     vkCmdBindVertexBuffers(cmdbuf, 0, 1, &s_skybox_buf, &offset);
@@ -2274,6 +3301,45 @@ static void Cmd_Render_Skybox(VkCommandBuffer cmdbuf)
 
     vkCmdEndRenderPass(cmdbuf);
 }
+//=============================================================================
+// Re-evaluates the attractor into s_particle_cache_buf when the seed or the palette blend
+// moved since the last evaluation. With the transform paused this records nothing and the
+// particle pass only runs VS_Particle_Cached.
+static void Cmd_Evaluate_Particles(VkCommandBuffer cmdbuf)
+{
+    float palette_factor = s_glob_state->palette_factor * s_glob_state->palette_factor * (3.0f - 2.0f * s_glob_state->palette_factor);
+
+    if (s_particle_cache_valid && s_particle_cache_seed == s_glob_state->seed && s_particle_cache_factor == palette_factor) return;
+
+    s_particle_cache_valid = 1;
+    s_particle_cache_seed = s_glob_state->seed;
+    s_particle_cache_factor = palette_factor;
+
+    VkBufferMemoryBarrier barrier;
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.pNext = NULL;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = s_particle_cache_buf;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+
+    // earlier frames may still be drawing from the cache
+    vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 1, &barrier, 0, NULL);
+
+    uint32_t group_count = SDL_min(((uint32_t)s_glob_state->point_count + 255) / 256, 65535u);
+
+    vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_COMPUTE, s_particle_evaluate_pipe);
+    vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_COMPUTE, s_common_pipeline_layout, 0, 1, &s_frame_dset, 1, &s_constant_offset);
+    vkCmdDispatch(cmdbuf, group_count, 1, 1);
+
+    // also orders the reads of later frames that skip the evaluation, they come after in submission order
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 0, NULL, 1, &barrier, 0, NULL);
+}
 //===========================================================================
 static int Graph_Init(GRAPH *graph, struct graph_data_t *data, int x, int y, int w, int h, float color[4], int draw_background)
 {
@@ -2289,24 +3355,6 @@ static int Graph_Init(GRAPH *graph, struct graph_data_t *data, int x, int y, int
     graph->color[3] = color[3];
     graph->draw_background = draw_background;
 
-    for (int i = 0; i < k_Resource_Buffering; ++i) {
-        const VkDeviceSize size = k_Graph_Samples * sizeof(GRAPH_SHADER_IN) * 3;
-        VkBufferCreateInfo buffer_info = {
-            VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, NULL, 0, size,
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, 0, NULL
-        };
-        VKU_VR(vkCreateBuffer(s_gpu_device, &buffer_info, NO_ALLOC_CALLBACK, &graph->buffer[i]));
-
-        VkMemoryRequirements mem_reqs;
-        vkGetBufferMemoryRequirements(s_gpu_device, graph->buffer[i], &mem_reqs);
-        VkMemoryAllocateInfo alloc_info = {
-            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, mem_reqs.size,
-            Get_Mem_Type_Index(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
-        };
-        VKU_VR(vkAllocateMemory(s_gpu_device, &alloc_info, NO_ALLOC_CALLBACK, &graph->buffer_mem[i]));
-        VKU_VR(vkBindBufferMemory(s_gpu_device, graph->buffer[i], graph->buffer_mem[i], 0));
-    }
-
     VkViewport vp = { (float)x, (float)y, (float)w, (float)h, 0.0f, 1.0f };
     VkRect2D scissor = { { x, y }, { w, h } };
 
@@ -2323,23 +3371,13 @@ static int Graph_Init(GRAPH *graph, struct graph_data_t *data, int x, int y, int
     return 1;
 }
 //---------------------------------------------------------------------------
-static void Graph_Release(GRAPH *graph)
-{
-    if (!graph) return;
-
-    for (int i = 0; i < k_Resource_Buffering; ++i) {
-        VKU_DESTROY(vkDestroyBuffer, graph->buffer[i]);
-        VKU_FREE_MEM(graph->buffer_mem[i]);
-    }
-}
-//---------------------------------------------------------------------------
 static void Graph_Draw(GRAPH *graph, VkCommandBuffer cmdbuf)
 {
     VkCommandBufferBeginInfo begin_info = {
         VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL, 0, NULL
     };
 
-    VkDeviceSize offset = 0;
+    VkDeviceSize offset = s_graph_common_offset;
 
     if (graph->draw_background) {
         vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, s_graph_tri_strip_pipe);
@@ -2347,37 +3385,38 @@ static void Graph_Draw(GRAPH *graph, VkCommandBuffer cmdbuf)
         vkCmdSetViewport(cmdbuf, 0, graph->viewport.viewportCount, &graph->viewport.viewport);
         vkCmdSetScissor(cmdbuf, 0, graph->viewport.scissorCount, &graph->viewport.scissors);
 
-        vkCmdBindVertexBuffers(cmdbuf, 0, 1, &s_graph_buffer[s_res_idx], &offset);
-        vkCmdBindVertexBuffers(cmdbuf, 1, 1, &s_graph_buffer[s_res_idx], &offset);
+        vkCmdBindVertexBuffers(cmdbuf, 0, 1, &s_upload_buf, &offset);
+        vkCmdBindVertexBuffers(cmdbuf, 1, 1, &s_upload_buf, &offset);
         vkCmdDraw(cmdbuf, 4, 1, 0, 0);
 
         vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, s_graph_line_list_pipe);
-        vkCmdBindVertexBuffers(cmdbuf, 0, 1, &s_graph_buffer[s_res_idx], &offset);
-        vkCmdBindVertexBuffers(cmdbuf, 1, 1, &s_graph_buffer[s_res_idx], &offset);
+        vkCmdBindVertexBuffers(cmdbuf, 0, 1, &s_upload_buf, &offset);
+        vkCmdBindVertexBuffers(cmdbuf, 1, 1, &s_upload_buf, &offset);
         vkCmdDraw(cmdbuf, 38, 1, 4, 0);
     }
 
     // fill
+    offset = graph->offset;
     vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, s_graph_tri_strip_pipe);
 
     vkCmdSetViewport(cmdbuf, 0, graph->viewport.viewportCount, &graph->viewport.viewport);
     vkCmdSetScissor(cmdbuf, 0, graph->viewport.scissorCount, &graph->viewport.scissors);
 
-    vkCmdBindVertexBuffers(cmdbuf, 0, 1, &graph->buffer[s_res_idx], &offset);
-    vkCmdBindVertexBuffers(cmdbuf, 1, 1, &graph->buffer[s_res_idx], &offset);
+    vkCmdBindVertexBuffers(cmdbuf, 0, 1, &s_upload_buf, &offset);
+    vkCmdBindVertexBuffers(cmdbuf, 1, 1, &s_upload_buf, &offset);
     vkCmdDraw(cmdbuf, k_Graph_Samples * 2, 1, 0, 0);
 
     // line
     vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, s_graph_line_strip_pipe);
-    vkCmdBindVertexBuffers(cmdbuf, 0, 1, &graph->buffer[s_res_idx], &offset);
-    vkCmdBindVertexBuffers(cmdbuf, 1, 1, &graph->buffer[s_res_idx], &offset);
+    vkCmdBindVertexBuffers(cmdbuf, 0, 1, &s_upload_buf, &offset);
+    vkCmdBindVertexBuffers(cmdbuf, 1, 1, &s_upload_buf, &offset);
     vkCmdDraw(cmdbuf, k_Graph_Samples, 1, k_Graph_Samples * 2, 0);
 }
 //-----------------------------------------------------------------------------
 static int Graph_Update_Buffer(GRAPH *graph, struct graph_data_t* data)
 {
-    GRAPH_SHADER_IN *ptr;
-    VKU_VR(vkMapMemory(s_gpu_device, graph->buffer_mem[s_res_idx], 0, VK_WHOLE_SIZE, 0, (void **)&ptr));
+    GRAPH_SHADER_IN *ptr = Upload_Alloc(k_Graph_Samples * sizeof(GRAPH_SHADER_IN) * 3, sizeof(GRAPH_SHADER_IN), &graph->offset);
+    if (!ptr) LOG_AND_RETURN0();
 
     // fill
     int idx = data->sampleidx;
@@ -2413,37 +3452,13 @@ static int Graph_Update_Buffer(GRAPH *graph, struct graph_data_t* data)
         ptr++;
     }
 
-    vkUnmapMemory(s_gpu_device, graph->buffer_mem[s_res_idx]);
-    return 1;
-}
-//===========================================================================
-static int Create_Common_Graph_Resources(void)
-{
-    for (int i = 0; i < k_Resource_Buffering; ++i) {
-        const VkDeviceSize size = 64 * sizeof(GRAPH_SHADER_IN);
-        VkBufferCreateInfo buffer_info = {
-            VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, NULL, 0, size,
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, 0, NULL
-        };
-        VKU_VR(vkCreateBuffer(s_gpu_device, &buffer_info, NO_ALLOC_CALLBACK, &s_graph_buffer[i]));
-
-        VkMemoryRequirements mem_reqs;
-        vkGetBufferMemoryRequirements(s_gpu_device, s_graph_buffer[i], &mem_reqs);
-        VkMemoryAllocateInfo alloc_info = {
-            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, mem_reqs.size,
-            Get_Mem_Type_Index(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
-        };
-        VKU_VR(vkAllocateMemory(s_gpu_device, &alloc_info, NO_ALLOC_CALLBACK, &s_graph_buffer_mem[i]));
-        VKU_VR(vkBindBufferMemory(s_gpu_device, s_graph_buffer[i], s_graph_buffer_mem[i], 0));
-    }
-
     return 1;
 }
 //===========================================================================
 static int Update_Common_Graph_Resources(void)
 {
-    GRAPH_SHADER_IN *ptr;
-    VKU_VR(vkMapMemory(s_gpu_device, s_graph_buffer_mem[s_res_idx], 0, VK_WHOLE_SIZE, 0, (void **)&ptr));
+    GRAPH_SHADER_IN *ptr = Upload_Alloc(64 * sizeof(GRAPH_SHADER_IN), sizeof(GRAPH_SHADER_IN), &s_graph_common_offset);
+    if (!ptr) LOG_AND_RETURN0();
 
     // background
     ptr->p.x = -1.0f; ptr->p.y = -1.0f;
@@ -2535,8 +3550,6 @@ static int Update_Common_Graph_Resources(void)
     ptr->c.x = 0.85f; ptr->c.y = 0.0f; ptr->c.z = 0.0f; ptr->c.w = 0.25f;
     ptr++;
 
-    vkUnmapMemory(s_gpu_device, s_graph_buffer_mem[s_res_idx]);
-
     return 1;
 }
 //===========================================================================
@@ -2545,24 +3558,6 @@ static int Create_Font_Resources(void)
     static unsigned char font24pixels[STB_FONT_consolas_24_usascii_BITMAP_HEIGHT][STB_FONT_consolas_24_usascii_BITMAP_WIDTH];
     stb_font_consolas_24_usascii(s_font_24_data, font24pixels, STB_FONT_consolas_24_usascii_BITMAP_HEIGHT);
 
-    for (int i = 0; i < k_Resource_Buffering; ++i) {
-        const VkDeviceSize size = 1024 * sizeof(VmathVector4);
-        VkBufferCreateInfo buffer_info = {
-            VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, NULL, 0, size,
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, 0, NULL
-        };
-        VKU_VR(vkCreateBuffer(s_gpu_device, &buffer_info, NO_ALLOC_CALLBACK, &s_font_buffer[i]));
-        VkMemoryRequirements mem_reqs;
-        vkGetBufferMemoryRequirements(s_gpu_device, s_font_buffer[i], &mem_reqs);
-
-        VkMemoryAllocateInfo alloc_info = {
-            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, mem_reqs.size,
-            Get_Mem_Type_Index(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
-        };
-        VKU_VR(vkAllocateMemory(s_gpu_device, &alloc_info, NO_ALLOC_CALLBACK, &s_font_buffer_mem[i]));
-        VKU_VR(vkBindBufferMemory(s_gpu_device, s_font_buffer[i], s_font_buffer_mem[i], 0));
-    }
-
     VkImageCreateInfo image_info = {
         VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO, NULL, 0,
         VK_IMAGE_TYPE_2D, VK_FORMAT_R8_UNORM,
@@ -2598,51 +3593,7 @@ static int Create_Font_Resources(void)
     memcpy(ptr, &font24pixels[0][0], STB_FONT_consolas_24_usascii_BITMAP_WIDTH * STB_FONT_consolas_24_usascii_BITMAP_HEIGHT);
     vkUnmapMemory(s_gpu_device, s_font_image_mem);
 
-    VkCommandBufferBeginInfo begin_info = {
-       VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL, 0, NULL
-    };
-    VKU_VR(vkBeginCommandBuffer(s_cmdbuf_display[0], &begin_info));
-    
-    VkImageSubresourceRange font_subresource_range;
-    font_subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    font_subresource_range.baseMipLevel = 0;
-    font_subresource_range.levelCount = 1;
-    font_subresource_range.baseArrayLayer = 0;
-    font_subresource_range.layerCount = 1;
-    
-    VkImageMemoryBarrier font_image_memory_barrier;
-    font_image_memory_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    font_image_memory_barrier.pNext = NULL;
-    font_image_memory_barrier.srcAccessMask = 0;
-    font_image_memory_barrier.dstAccessMask = 0;
-    font_image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
-    font_image_memory_barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-    font_image_memory_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    font_image_memory_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    font_image_memory_barrier.image = s_font_image;
-    font_image_memory_barrier.subresourceRange = font_subresource_range;
-
-    vkCmdPipelineBarrier(s_cmdbuf_display[0], VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, 0, NULL, 0, NULL, 1, &font_image_memory_barrier);
-
-    VKU_VR(vkEndCommandBuffer(s_cmdbuf_display[0]));
-
-    VkSubmitInfo submit_info;
-    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.pNext = NULL;
-    submit_info.waitSemaphoreCount = 0;
-    submit_info.pWaitSemaphores = NULL;
-    submit_info.pWaitDstStageMask = NULL;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = s_cmdbuf_display;
-    submit_info.signalSemaphoreCount = 0;
-    submit_info.pSignalSemaphores = NULL;
-    if (vkQueueSubmit(s_gpu_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
-        LOG_AND_RETURN0();
-    }
-    if (vkQueueWaitIdle(s_gpu_queue) != VK_SUCCESS) {
-        LOG_AND_RETURN0();
-    }
-
+    // the transition to VK_IMAGE_LAYOUT_GENERAL is recorded by Upload_Textures
     return 1;
 }
 //----------------------------------------------------------------------------
@@ -2733,7 +3684,7 @@ static int Create_Font_Pipeline(void)
         NULL, s_common_pipeline_layout, s_win_renderpass, 0, VK_NULL_HANDLE, 0
     };
 
-    VkResult r = vkCreateGraphicsPipelines(s_gpu_device, VK_NULL_HANDLE, 1, &pi_info, NO_ALLOC_CALLBACK, &s_font_pipe);
+    VkResult r = Create_Graphics_Pipeline(&pi_info, &s_font_pipe);
 
     VKU_DESTROY(vkDestroyShaderModule, vs);
     VKU_DESTROY(vkDestroyShaderModule, fs);
@@ -2749,7 +3700,8 @@ static int Add_Text(VmathVector4 **ptr, const char *str, int x, int y)
     float recip_height = 1.0f / s_glob_state->height;
     int letters = 0;
 
-    while (*str) {
+    // the caller adds letters to s_font_letter_count afterwards
+    while (*str && s_font_letter_count + letters < k_Font_Max_Letters) {
         int char_codepoint = *str++;
         stb_fontchar *cd = &s_font_24_data[char_codepoint - STB_FONT_consolas_24_usascii_FIRST_CHAR];
 
@@ -2790,32 +3742,61 @@ static int Generate_Text(void)
 {
     s_font_letter_count = 0;
 
-    VmathVector4 *ptr;
-    VKU_VR(vkMapMemory(s_gpu_device, s_font_buffer_mem[s_res_idx], 0, VK_WHOLE_SIZE, 0, (void **)&ptr));
+    VmathVector4 *ptr = Upload_Alloc(k_Font_Max_Letters * 4 * sizeof(VmathVector4), sizeof(VmathVector4), &s_font_offset);
+    if (!ptr) LOG_AND_RETURN0();
 
     char str[128];
     sprintf(str, "CPU Load");
     s_font_letter_count += Add_Text(&ptr, str, s_glob_state->width - 10 - k_Graph_Width, 10);
 
+    if (s_timestamp_pool) {
+        sprintf(str, "GPU %.2f ms", s_gpu_ms[GPU_PASS_FRAME]);
+        s_font_letter_count += Add_Text(&ptr, str, s_glob_state->width - 20 - 2 * k_Graph_Width, 10);
+
+        sprintf(str, "GPU ms: clear %.2f, skybox %.2f, compute %.2f, particles %.2f, display %.2f, HUD %.2f",
+                s_gpu_ms[GPU_PASS_CLEAR], s_gpu_ms[GPU_PASS_SKYBOX], s_gpu_ms[GPU_PASS_COMPUTE],
+                s_gpu_ms[GPU_PASS_PARTICLES], s_gpu_ms[GPU_PASS_DISPLAY], s_gpu_ms[GPU_PASS_HUD]);
+        s_font_letter_count += Add_Text(&ptr, str, 10, s_glob_state->height - 330);
+    }
+
+    sprintf(str, "Particles: %s command buffers%s (F1/F2)", s_glob_state->secondary_cmdbufs ? "secondary" : "primary",
+            s_glob_state->prerecorded ? ", prerecorded" : "");
+    s_font_letter_count += Add_Text(&ptr, str, 10, s_glob_state->height - 120);
+
+    static const char *draw_mode_name[DRAW_MODE_COUNT] = { "vkCmdDraw", "vkCmdDrawIndirect" };
+    sprintf(str, "Draw: %s%s (F4)", draw_mode_name[s_particle_draw_mode],
+            s_particle_draw_mode != DRAW_MODE_DIRECT && s_gpu_features.multiDrawIndirect ? ", multi" : "");
+    s_font_letter_count += Add_Text(&ptr, str, 10, s_glob_state->height - 180);
+
+    sprintf(str, "Positions: %s (F5)", s_particle_cached ? "cached" : "per frame");
+    s_font_letter_count += Add_Text(&ptr, str, 10, s_glob_state->height - 240);
+
+    sprintf(str, "Constants: %s", s_push_constants ? "push constants" : "storage buffer");
+    s_font_letter_count += Add_Text(&ptr, str, 10, s_glob_state->height - 270);
+
+    sprintf(str, "Trace: %.80s (F6)", s_glob_state->trace_file ? s_glob_state->trace_file : k_Trace_File);
+    s_font_letter_count += Add_Text(&ptr, str, 10, s_glob_state->height - 300);
+
+    sprintf(str, "Frames in flight: %d (F3)", SDL_max(1, SDL_min(s_glob_state->frames_in_flight, k_Resource_Buffering)));
+    s_font_letter_count += Add_Text(&ptr, str, 10, s_glob_state->height - 150);
+
     sprintf(str, "FPS %.1f (%.3f ms)", s_fps, s_ms);
  
     s_font_letter_count += Add_Text(&ptr, str, 10, s_glob_state->height - 90);
     s_font_letter_count += Add_Text(&ptr, "Stardust 1.1", 10, s_glob_state->height - 60);
     s_font_letter_count += Add_Text(&ptr, s_gpu_properties.deviceName, 10, s_glob_state->height - 30);
 
-    vkUnmapMemory(s_gpu_device, s_font_buffer_mem[s_res_idx]);
-
     return 1;
 }
 //-----------------------------------------------------------------------------
 static void Cmd_Draw_Text(VkCommandBuffer cmdbuf)
 {
     vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, s_font_pipe);
-    vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, s_common_pipeline_layout, 0, 1, &s_common_dset[s_res_idx], 0, NULL);
+    vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, s_common_pipeline_layout, 0, 1, &s_frame_dset, 1, &s_constant_offset);
 
-    VkDeviceSize offsets = 0;
-    vkCmdBindVertexBuffers(cmdbuf, 0, 1, &s_font_buffer[s_res_idx], &offsets);
-    vkCmdBindVertexBuffers(cmdbuf, 1, 1, &s_font_buffer[s_res_idx], &offsets);
+    VkDeviceSize offsets = s_font_offset;
+    vkCmdBindVertexBuffers(cmdbuf, 0, 1, &s_upload_buf, &offsets);
+    vkCmdBindVertexBuffers(cmdbuf, 1, 1, &s_upload_buf, &offsets);
     for (int i = 0; i < s_font_letter_count; ++i) {
         vkCmdDraw(cmdbuf, 4, 1, i * 4, 0);
     }
@@ -2833,20 +3814,96 @@ static uint32_t Get_Mem_Type_Index(VkMemoryPropertyFlagBits bit)
     }
     LOG_AND_RETURN0();
 }
+//-----------------------------------------------------------------------------
+// Integrated and CPU devices expose device local memory to the host, static data is written
+// in place there instead of going through a staging copy.
+static int Get_UMA_Mem_Type_Index(uint32_t type_bits, uint32_t *index)
+{
+    if (s_gpu_properties.deviceType != VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU &&
+        s_gpu_properties.deviceType != VK_PHYSICAL_DEVICE_TYPE_CPU) return 0;
+
+    VkPhysicalDeviceMemoryProperties physMemProperties;
+    vkGetPhysicalDeviceMemoryProperties(s_gpu, &physMemProperties);
+
+    const VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    for (uint32_t i = 0; i < physMemProperties.memoryTypeCount; ++i) {
+        if ((type_bits & (1u << i)) && (physMemProperties.memoryTypes[i].propertyFlags & flags) == flags) {
+            *index = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+//-----------------------------------------------------------------------------
+// First memory type allowed by the resource's memoryTypeBits that has all of flags.
+static int Find_Mem_Type_Index(uint32_t type_bits, VkMemoryPropertyFlags flags, uint32_t *index)
+{
+    VkPhysicalDeviceMemoryProperties physMemProperties;
+    vkGetPhysicalDeviceMemoryProperties(s_gpu, &physMemProperties);
+
+    for (uint32_t i = 0; i < physMemProperties.memoryTypeCount; ++i) {
+        if ((type_bits & (1u << i)) && (physMemProperties.memoryTypes[i].propertyFlags & flags) == flags) {
+            *index = i;
+            return 1;
+        }
+    }
+    LOG_AND_RETURN0();
+}
+//=============================================================================
+// Command line values that exceed the limits of the device, see Parse_Command_Line.
+static int Validate_Config(void)
+{
+    const VkPhysicalDeviceLimits *limits = &s_gpu_properties.limits;
+    // the seeds are always bound, the four times larger position cache only with -cached
+    const uint64_t particle_size = (uint64_t)s_glob_state->point_count *
+                                   (s_glob_state->cached_positions ? sizeof(VmathVector4) : sizeof(uint32_t));
+    int ok = 1;
+
+    Enable_Logging(1);
+
+    if (particle_size > limits->maxStorageBufferRange) {
+        Log("-points %d needs a %llu byte storage buffer, maxStorageBufferRange is %u\n",
+            s_glob_state->point_count, (unsigned long long)particle_size, limits->maxStorageBufferRange);
+        ok = 0;
+    }
+    if ((uint32_t)s_glob_state->width > SDL_min(limits->maxImageDimension2D, limits->maxFramebufferWidth) ||
+        (uint32_t)s_glob_state->height > SDL_min(limits->maxImageDimension2D, limits->maxFramebufferHeight)) {
+        Log("-resolution %dx%d exceeds the framebuffer limit of %ux%u\n", s_glob_state->width, s_glob_state->height,
+            limits->maxFramebufferWidth, limits->maxFramebufferHeight);
+        ok = 0;
+    }
+    Enable_Logging(s_glob_state->verbose);
+
+    return ok;
+}
 //=============================================================================
 int VK_Init(struct glob_state_t* state)
 {
     s_glob_state = state;
+    s_headless = state->headless;
 
-    if (!VKU_Create_Device(state->hwnd, state->width, state->height, k_Window_Buffering, state->windowed,
-                           &s_queue_family_index, &s_gpu_device, &s_gpu_queue,
-                           s_win_images, &s_swap_chain, &s_gpu)) {
+    if (s_headless) {
+        if (!VKU_Create_Headless_Device(&s_queue_family_index, &s_gpu_device, &s_gpu_queue, &s_gpu)) {
+            Log("VKU_Create_Headless_Device failed\n");
+            return STARDUST_NOT_SUPPORTED;
+        }
+    } else if (!VKU_Create_Device(state->hwnd, state->width, state->height, k_Window_Buffering, state->windowed,
+                                  &s_queue_family_index, &s_gpu_device, &s_gpu_queue, s_win_images, &s_swap_chain,
+                                  state->present_mode < 0 ? VK_PRESENT_MODE_MAX_ENUM_KHR : (VkPresentModeKHR)state->present_mode,
+                                  &s_gpu)) {
         Log("VKU_Create_Device failed\n");
         return STARDUST_NOT_SUPPORTED;
     }
     Log("VK Device initialized\n");
 
     vkGetPhysicalDeviceProperties(s_gpu, &s_gpu_properties);
+    vkGetPhysicalDeviceFeatures(s_gpu, &s_gpu_features);
+
+    if (!Validate_Config()) {
+        return STARDUST_NOT_SUPPORTED;
+    }
+    Log_Config(state);
 
     if (!Demo_Init()) {
         Log("Demo_Init failed\n");
@@ -2858,6 +3915,120 @@ int VK_Init(struct glob_state_t* state)
     return STARDUST_CONTINUE;
 }
 //=============================================================================
+// The report repeats the effective configuration, so runs of a sweep can be told apart.
+static int Init_Benchmark(void)
+{
+    const struct glob_state_t *state = s_glob_state;
+
+    if (!Benchmark_Init(state->warmup_frames, state->frame_count, PHASE_COUNT, s_phase_name,
+                        GPU_PASS_COUNT, s_gpu_pass_name, state->cpu_core_count))
+        LOG_AND_RETURN0();
+
+    char driver_version[32];
+    sprintf(driver_version, "0x%x", s_gpu_properties.driverVersion);
+    Benchmark_Config_String("device", s_gpu_properties.deviceName);
+    Benchmark_Config_String("driver_version", driver_version);
+    Benchmark_Config_Int("points", state->point_count);
+    Benchmark_Config_Int("batch", state->batch_size);
+    Benchmark_Config_Int("workers", state->cpu_core_count);
+    Benchmark_Config_Int("frames_in_flight", state->frames_in_flight);
+    Benchmark_Config_String("submit", Submit_Mode_Name(state));
+    Benchmark_Config_String("draw", Draw_Mode_Name(state->draw_mode));
+    Benchmark_Config_Int("multi_draw_indirect", s_gpu_features.multiDrawIndirect);
+    Benchmark_Config_Int("cached", state->cached_positions);
+    Benchmark_Config_Int("push_constants", s_push_constants);
+    Benchmark_Config_Int("width", state->width);
+    Benchmark_Config_Int("height", state->height);
+    Benchmark_Config_String("mode", state->headless ? "headless" : state->windowed ? "windowed" : "fullscreen");
+    Benchmark_Config_String("present", Present_Mode_Name(state->present_mode));
+
+    return 1;
+}
+//=============================================================================
+static void Write_Trace(void)
+{
+    const char *filename = s_glob_state->trace_file ? s_glob_state->trace_file : k_Trace_File;
+
+    if (Trace_Write(filename)) Log("Trace written to %s\n", filename);
+    else Log("Failed to write %s\n", filename);
+}
+//=============================================================================
+// -verify: reads back the cache of the last CS_Particle_Evaluate dispatch and compares it with
+// Particle_CPU_Evaluate for the same seed and palette factor. Runs after the frame loop, when
+// no particle jobs are outstanding, so the CPU reference can use the job workers.
+static int Verify_Particle_Cache(void)
+{
+    if (!s_particle_cache_buf || !s_particle_cache_valid) {
+        Log("Verify: the particle cache was never evaluated\n");
+        return 0;
+    }
+    const int count = s_glob_state->point_count;
+    const VkDeviceSize size = (VkDeviceSize)count * sizeof(VmathVector4);
+
+    VkBuffer readback_buf = VK_NULL_HANDLE;
+    VkDeviceMemory readback_mem = VK_NULL_HANDLE;
+    VkBufferCreateInfo buffer_info = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, NULL, 0, size,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_SHARING_MODE_EXCLUSIVE, 0, NULL
+    };
+    VKU_VR(vkCreateBuffer(s_gpu_device, &buffer_info, NO_ALLOC_CALLBACK, &readback_buf));
+
+    VkMemoryRequirements mem_reqs;
+    vkGetBufferMemoryRequirements(s_gpu_device, readback_buf, &mem_reqs);
+
+    VkMemoryAllocateInfo alloc_info = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, mem_reqs.size, 0 };
+    int ok = Find_Mem_Type_Index(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                 &alloc_info.memoryTypeIndex);
+    if (ok) ok = vkAllocateMemory(s_gpu_device, &alloc_info, NO_ALLOC_CALLBACK, &readback_mem) == VK_SUCCESS;
+    if (ok) ok = vkBindBufferMemory(s_gpu_device, readback_buf, readback_mem, 0) == VK_SUCCESS;
+    if (ok) ok = Copy_Buffer_And_Wait(s_particle_cache_buf, readback_buf, size,
+                                      VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                      VK_ACCESS_HOST_READ_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+
+    const float *gpu = NULL;
+    uint32_t *seeds = malloc((size_t)count * sizeof(uint32_t));
+    float *cpu = malloc((size_t)count * 4 * sizeof(float));
+    if (ok) ok = seeds && cpu && vkMapMemory(s_gpu_device, readback_mem, 0, size, 0, (void **)&gpu) == VK_SUCCESS;
+
+    int match_count = 0;
+    float max_error = 0.0f;
+    if (ok) {
+        Uint64 begin = SDL_GetPerformanceCounter();
+        Rnd_Fill(k_Particle_Seed, seeds, count);
+        Particle_CPU_Evaluate(seeds, count, s_particle_cache_seed, s_particle_cache_factor, cpu);
+        double ms = 1000.0 * (SDL_GetPerformanceCounter() - begin) / SDL_GetPerformanceFrequency();
+
+        for (int i = 0; i < count; ++i) {
+            const float *c = cpu + (size_t)i * 4;
+            const float *g = gpu + (size_t)i * 4;
+            float error = 0.0f;
+            int mismatch = 0;
+
+            // a component that escaped to inf or nan only matches the same escape
+            for (int k = 0; k < 4; ++k) {
+                if (isfinite(c[k]) && isfinite(g[k])) error = SDL_max(error, fabsf(g[k] - c[k]) / SDL_max(1.0f, fabsf(c[k])));
+                else if (isfinite(c[k]) || isfinite(g[k])) mismatch = 1;
+            }
+            if (mismatch) continue;
+            if (error <= k_Verify_Epsilon) match_count++;
+            max_error = SDL_max(max_error, error);
+        }
+        vkUnmapMemory(s_gpu_device, readback_mem);
+
+        ok = match_count >= k_Verify_Min_Match * count;
+        Log("Verify: %d of %d particles within %g of the %s CPU reference (%.1f ms), max error %g, %s\n",
+            match_count, count, k_Verify_Epsilon, Particle_CPU_Kernel_Name(), ms, max_error, ok ? "passed" : "FAILED");
+    }
+    else Log("Verify: failed to read back the particle cache\n");
+
+    free(seeds);
+    free(cpu);
+    VKU_DESTROY(vkDestroyBuffer, readback_buf);
+    VKU_FREE_MEM(readback_mem);
+
+    return ok;
+}
+//=============================================================================
 int VK_Run(struct glob_state_t *state)
 {
     s_glob_state = state;
@@ -2867,44 +4038,59 @@ int VK_Run(struct glob_state_t *state)
     s_glob_state->frame = 0;
     s_res_idx = 0;
 
-    char title[256];
-    Get_Window_Title(title, "Vulkan");
-    SDL_SetWindowTitle(state->window, title);
+    if (!s_headless) {
+        char title[256];
+        Get_Window_Title(title, "Vulkan");
+        SDL_SetWindowTitle(state->window, title);
+    }
+    if (state->benchmark && !Init_Benchmark()) {
+        Log("Init_Benchmark failed\n");
+        Set_Exit_Code(STARDUST_ERROR);
+    }
+    Uint64 run_begin = SDL_GetPerformanceCounter();
 
 #ifdef MT_UPDATE
     Set_Exit_Code(STARDUST_CONTINUE);
-    for (int i = 1; i < s_glob_state->cpu_core_count; ++i) {
-        s_thread[i].thread = SDL_CreateThread(Particle_Thread, "thrd", &s_thread[i]);
-        if (!s_thread[i].thread) LOG_AND_RETURN0();
-    }
 #endif
 
+    if (!Begin_Frame(0)) {
+        Log("Begin_Frame failed\n");
+        Set_Exit_Code(STARDUST_ERROR);
+    }
+
     while (s_exit_code == STARDUST_CONTINUE) {
         int recalculate_fps = Update_Frame_Stats(&s_time, &s_time_delta, s_glob_state->frame,
                                                  0, &s_fps, &s_ms);
 
-        Set_Exit_Code(Handle_Events(s_glob_state));
-
-        VkSemaphoreCreateInfo semaphoreInfo;
-        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-        semaphoreInfo.pNext = NULL;
-        semaphoreInfo.flags = 0;
-        VKU_VR(vkCreateSemaphore(s_gpu_device, &semaphoreInfo, NO_ALLOC_CALLBACK,
-                                 &s_swap_chain_image_ready_semaphore));
-
-        uint32_t swap_image_index;
-        VKU_VR(vkAcquireNextImageKHR(s_gpu_device, s_swap_chain, UINT64_MAX,
-                                     s_swap_chain_image_ready_semaphore, VK_NULL_HANDLE, &swap_image_index));
-
-        s_res_idx = swap_image_index;
-        s_win_idx = swap_image_index;
+        if (!s_headless) {
+            Set_Exit_Code(Handle_Events(s_glob_state));
+        }
+        if (s_glob_state->benchmark) {
+            if (Benchmark_Measured_Count() + 1 >= s_glob_state->frame_count) Set_Exit_Code(STARDUST_EXIT);
+        }
+        else if (s_glob_state->frame_count && s_glob_state->frame + 1 >= s_glob_state->frame_count) Set_Exit_Code(STARDUST_EXIT);
 
         if (!Demo_Update()) {
             Log("Demo_Update failed\n");
             Set_Exit_Code(STARDUST_ERROR);
         }
+        // no particle jobs are in flight between Demo_Update and the next Begin_Frame
+        Benchmark_Frame();
+        if (s_glob_state->trace_requested) {
+            s_glob_state->trace_requested = 0;
+            Write_Trace();
+        }
         s_glob_state->frame++;
 
+        // the next frame is recorded while this one is presented
+        uint32_t swap_image_index = s_win_idx;
+        VkSemaphore render_done = s_render_done_semaphore[s_res_idx];
+        int frames_in_flight = SDL_max(1, SDL_min(s_glob_state->frames_in_flight, k_Resource_Buffering));
+        if (!Begin_Frame((s_res_idx + 1) % frames_in_flight)) {
+            Log("Begin_Frame failed\n");
+            Set_Exit_Code(STARDUST_ERROR);
+        }
+
         if (recalculate_fps) {
             const float *cpu_load = Metrics_GetCPUData();
 
@@ -2914,31 +4100,59 @@ int VK_Run(struct glob_state_t *state)
                 Graph_Add_Sample(&s_glob_state->graph_data[i], s / 100.0f);
                 Log("CPU %d: %f", i, cpu_load[i]);
             }
+            if (s_gpu_graph_count) {
+                Graph_Add_Sample(&s_gpu_graph_data, SDL_min(s_gpu_graph_sum / s_gpu_graph_count / k_Gpu_Graph_Ms, 1.0f));
+                s_gpu_graph_sum = 0.0f;
+                s_gpu_graph_count = 0;
+            }
         }
 
-        swap_image_index = s_win_idx;
-        if (!VKU_Present(&swap_image_index)) {
-            Log("VKU_Present failed\n");
-            Set_Exit_Code(STARDUST_ERROR);
+        if (!s_headless) {
+            Uint64 present_begin = SDL_GetPerformanceCounter();
+            if (!VKU_Present(&swap_image_index, render_done)) {
+                Log("VKU_Present failed\n");
+                Set_Exit_Code(STARDUST_ERROR);
+            }
+            Trace_End(0, "VKU_Present", present_begin);
+            Benchmark_End_Phase(PHASE_PRESENT, present_begin);
         }
-        VKU_DESTROY(vkDestroySemaphore, s_swap_chain_image_ready_semaphore);
     }
+    Finish_Particle_Recording();
 
-    if (s_exit_code != STARDUST_EXIT)
+    if (s_headless || s_glob_state->frame_count) {
+        vkDeviceWaitIdle(s_gpu_device);
+        double seconds = (double)(SDL_GetPerformanceCounter() - run_begin) / SDL_GetPerformanceFrequency();
+        Log("Run: %d frames in %.2f s, %.3f ms per frame, %.1f fps\n", s_glob_state->frame, seconds,
+            1000.0 * seconds / SDL_max(s_glob_state->frame, 1), s_glob_state->frame / seconds);
+    }
+    if (s_glob_state->trace_file) {
+        Write_Trace();
+    }
+    if (s_glob_state->verify && s_exit_code == STARDUST_EXIT) {
+        vkDeviceWaitIdle(s_gpu_device);
+        Enable_Logging(1);
+        // a mismatch is a result, not a programming error, so the exit code is set without the assert
+        if (!Verify_Particle_Cache()) s_exit_code = STARDUST_ERROR;
+        Enable_Logging(s_glob_state->verbose);
+    }
+    if (s_glob_state->benchmark) {
+        Enable_Logging(1);
+        Benchmark_Log_Summary();
+        if (s_glob_state->output_file && !Benchmark_Write_Report(s_glob_state->output_file)) {
+            Log("Failed to write %s\n", s_glob_state->output_file);
+        }
+        Enable_Logging(s_glob_state->verbose);
+        Benchmark_Shutdown();
+    }
+    if (!s_headless && s_exit_code != STARDUST_EXIT)
     {
         uint32_t swap_image_index = 0xffffffff;
-        VKU_Present(&swap_image_index);
+        VKU_Present(&swap_image_index, VK_NULL_HANDLE);
     }
 
     s_res_idx = 0;
     s_win_idx = 0;
 
-#ifdef MT_UPDATE
-    for (int i = 1; i < s_glob_state->cpu_core_count; ++i) {
-        Finish_Particle_Thread(&s_thread[i]);
-    }
-#endif
-
     return s_exit_code;
 }
 //=============================================================================